@@ -109,6 +109,14 @@ export interface WebSocket<UserData> {
 }
 
 /** An HttpResponse is valid until either onAborted callback or any of the .end/.tryEnd calls succeed. You may attach user data to this object. */
+/** Request headers for res.streamFile range support, usually req.getHeader("range") and req.getHeader("if-range"). */
+export interface StreamFileOptions {
+    range?: string;
+    ifRange?: string;
+    /** Content-Type of the file, used for partial responses */
+    contentType?: string;
+}
+
 export interface HttpResponse {
     /** Writes the HTTP status message such as "200 OK".
      * This has to be called first in any response, otherwise
@@ -136,6 +144,13 @@ export interface HttpResponse {
      * See writeStatus and corking.
     */
     writeHeader(key: RecognizedString, value: RecognizedString) : HttpResponse;
+    /** Writes many headers in one call, given as flat array [key, value, key, value, ...] or as object. Numbers are accepted as values,
+     * non-integer or negative ones are written in their string form. All of them are checked before any is written.
+     * See writeStatus and corking.
+    */
+    writeHeaders(headers: (RecognizedString | number)[] | Record<string, RecognizedString | number>) : HttpResponse;
+    /** Writes status (if given), headers (see writeHeaders) and ends the response with body, all in one call. Nothing is written if any argument is invalid. */
+    respond(status?: RecognizedString, headers?: (RecognizedString | number)[] | Record<string, RecognizedString | number>, body?: RecognizedString) : HttpResponse;
     /** Enters or continues chunked encoding mode. Writes part of the response. End with zero length write. Returns true if no backpressure was added. */
     write(chunk: RecognizedString) : boolean;
     /** Ends this response by copying the contents of body. */
@@ -145,6 +160,16 @@ export interface HttpResponse {
     /** Ends this response, or tries to, by streaming appropriately sized chunks of body. Use in conjunction with onWritable. Returns tuple [ok, hasResponded].*/
     tryEnd(fullBodyOrChunk: RecognizedString, totalSize: number) : [boolean, boolean];
 
+    /** Ends this response with the contents of a file, given as path or file descriptor (which is closed).
+     * With options, regular files answer range requests: pass the request's Range and If-Range headers, the response becomes
+     * a 206 (multipart/byteranges for several ranges) or 416, and always carries Accept-Ranges, ETag and Last-Modified.
+     * Don't write a status yourself in that case.
+     * Paths are opened and files are read without blocking the event loop. A path that can't be opened does not throw,
+     * the response is answered with 404 Not Found once the open failed. A handler given to onAborted before still runs
+     * if the client goes away before the file is sent.
+     */
+    streamFile(file: RecognizedString | number, options?: StreamFileOptions) : void;
+
     /** Sets the default error page template with a {{message}} placeholder. */
     setDefaultErrorPage(html: RecognizedString) : HttpResponse;
 
@@ -171,6 +196,9 @@ export interface HttpResponse {
 
     /** Handler for reading data from POST and such requests. You MUST copy the data of chunk if isLast is not true. We Neuter ArrayBuffers on return, making it zero length.*/
     onData(handler: (chunk: ArrayBuffer, isLast: boolean) => void) : HttpResponse;
+    /** Same as above, but chunks are always given as Uint8Array. Small ones are copied into a shared per-loop buffer, avoiding an allocation per chunk,
+     * and neutered at the end of the event loop iteration. Larger ones are views of their own ArrayBuffer, neutered on return as above. */
+    onData(handler: (chunk: Uint8Array, isLast: boolean) => void, reuseBuffers: boolean) : HttpResponse;
 
     /** Returns the remote IP address in binary format (4 or 16 bytes). */
     getRemoteAddress() : ArrayBuffer;
@@ -210,6 +238,22 @@ export interface HttpResponse {
 
 /** An HttpRequest is stack allocated and only accessible during the callback invocation. */
 export interface HttpRequest {
+    /** The HTTP method as-is. This and the properties below are computed on first read. When the handler returns a promise, the ones not read yet are computed as it returns, so they stay readable after an await. */
+    method: string;
+    /** The origin header or empty string. */
+    origin: string;
+    /** Whether the request arrived over SSL. */
+    secure: boolean;
+    /** The host header, including port. */
+    host: string;
+    /** The host header without port. */
+    domain: string;
+    /** The percent-decoded URL, without the query. */
+    path: string;
+    /** The content-type header, only set for POST, PUT, PATCH and DELETE. */
+    contentType?: string;
+    /** The content-length header, only set for POST, PUT, PATCH and DELETE. */
+    contentLength?: string;
     /** Returns the lowercased header value or empty string. */
     getHeader(lowerCaseKey: RecognizedString) : string;
     /** Returns the parsed parameter at index. Corresponds to route. Can also take the name of the parameter. */
@@ -226,6 +270,10 @@ export interface HttpRequest {
     getQuery(key: string) : string | undefined;
     /** Loops over all headers. */
     forEach(cb: (key: string, value: string) => void) : void;
+    /** Returns all headers as a flat array of lowercased names and values: [name, value, name, value, ...]. Cheaper than forEach. */
+    getHeaders() : string[];
+    /** Returns the values of the given lowercased headers, in the same order. Missing headers are empty strings. */
+    getHeaders(lowerCaseKeys: RecognizedString[]) : string[];
     /** Setting yield to true is to say that this route handler did not handle the route, causing the router to continue looking for a matching route handler, or fail. */
     setYield(_yield: boolean) : HttpRequest;
 }
@@ -248,6 +296,9 @@ export interface WebSocketBehavior<UserData> {
     maxBackpressure?: number;
     /** Whether or not we should automatically send pings to uphold a stable connection given whatever idleTimeout. */
     sendPingsAutomatically?: boolean;
+    /** Whether message, dropped, ping and pong payloads are given as Uint8Array instead of ArrayBuffer. Small ones are views into a shared per-loop buffer
+     * instead of a new ArrayBuffer each, neutered at the end of the event loop iteration rather than on return. Defaults to false. */
+    reuseBuffers?: boolean;
     /** Upgrade handler used to intercept HTTP upgrade requests and potentially upgrade to WebSocket.
      * See UpgradeAsync and UpgradeSync example files.
      */
@@ -256,6 +307,10 @@ export interface WebSocketBehavior<UserData> {
     open?: (ws: WebSocket<UserData>) => void | Promise<void>;
     /** Handler for a WebSocket message. Messages are given as ArrayBuffer no matter if they are binary or not. Given ArrayBuffer is valid during the lifetime of this callback (until first await or return) and will be neutered. */
     message?: (ws: WebSocket<UserData>, message: ArrayBuffer, isBinary: boolean) => void | Promise<void>;
+    /** Replaces message. Collects all messages received during one event loop iteration (across all sockets of this route) and delivers them in one call.
+     * Message i was sent by sockets[i] and is data.slice(offsets[i], offsets[i + 1]). Pending messages are always delivered before the close event of their socket.
+     * The data ArrayBuffer is neutered on return. */
+    messageBatch?: (sockets: WebSocket<UserData>[], offsets: Uint32Array, data: ArrayBuffer, isBinary: Uint8Array) => void;
     /** Handler for a dropped WebSocket message. Messages can be dropped due to specified backpressure settings. Messages are given as ArrayBuffer no matter if they are binary or not. Given ArrayBuffer is valid during the lifetime of this callback (until first await or return) and will be neutered. */
     dropped?: (ws: WebSocket<UserData>, message: ArrayBuffer, isBinary: boolean) => void | Promise<void>;
     /** Handler for when WebSocket backpressure drains. Check ws.getBufferedAmount(). Use this to guide / drive your backpressure throttling. */
@@ -282,6 +337,10 @@ export interface AppOptions {
     ssl_ciphers?: RecognizedString;
     /** This translates to SSL_MODE_RELEASE_BUFFERS */
     ssl_prefer_low_memory_usage?: boolean;
+    /** HTTPSProtocol only, Linux only. res.streamFile hands the connection's TLS encryption to the kernel (kTLS) once the
+     * response head is sent, so the file goes out with sendfile. The connection closes after such a response. Without the
+     * tls kernel module, or with a cipher other than AES-GCM or ChaCha20-Poly1305, files are encrypted in user space as usual. */
+    ktls?: boolean;
 }
 
 export enum ListenOptions {
@@ -290,6 +349,16 @@ export enum ListenOptions {
 }
 
 /** TemplatedApp is either an SSL or non-SSL app. See App for more info, read user manual. */
+/** Cache options of TemplatedApp.route */
+export interface RouteCacheOptions {
+    /** How long a response is reused, in milliseconds. */
+    ttl: number;
+    /** Query parameters that select a different response. */
+    query?: string[];
+    /** Request headers that select a different response. */
+    vary?: string[];
+}
+
 export interface TemplatedApp {
     /** Listens to hostname & port. Callback hands either false or a listen socket. */
     listen(host: RecognizedString, port: number, cb: (listenSocket: us_listen_socket | false) => void | Promise<void>) : TemplatedApp;
@@ -319,6 +388,15 @@ export interface TemplatedApp {
     trace(pattern: RecognizedString, handler: (res: HttpResponse, req: HttpRequest) => void | Promise<void>) : TemplatedApp;
     /** Registers an HTTP handler matching specified URL pattern on any HTTP method. */
     any(pattern: RecognizedString, handler: (res: HttpResponse, req: HttpRequest) => void | Promise<void>) : TemplatedApp;
+    /** Routes a domain pattern to a handler. With { pooled: true } the req/res objects are reused across requests,
+     * so the handler must not keep them past its return, they don't take new properties and req properties are read-only.
+     * If the handler returns a promise, its req/res are not reused and the req properties stay readable after an await.
+     * With { cache: { ttl } } the first 2xx response (without set-cookie) to a GET request per host, path, listed query parameters
+     * and listed request headers is kept for ttl milliseconds and served natively, the handler is not called for those hits.
+     * Other methods always reach the handler, and so do requests with an Authorization or Cookie header unless that header is listed
+     * in vary. Responses with Cache-Control no-store, private or no-cache are not kept. A route keeps up to 1024 responses and 8 MB, dropping the oldest ones first.
+     * On misses res is a CachedHttpResponse, which supports writeStatus, writeHeader(s), write, end, respond, cork and onAborted. */
+    route(pattern: RecognizedString, handler: ((req: HttpRequest, res: HttpResponse) => void | Promise<void>) | null, options?: { pooled?: boolean, cache?: RouteCacheOptions }) : TemplatedApp;
     /** Registers a handler matching specified URL pattern where WebSocket upgrade requests are caught. */
     ws<UserData>(pattern: RecognizedString, behavior: WebSocketBehavior<UserData>) : TemplatedApp;
     /** Publishes a message under topic, for all WebSockets under this app. See WebSocket.publish. */
@@ -363,6 +441,9 @@ export interface MultipartField {
 /** Takes a POSTed body and contentType, and returns an array of parts if the request is a multipart request */
 export function getParts(body: RecognizedString, contentType: RecognizedString) : MultipartField[] | undefined;
 
+/** Returns how many times this thread's event loop has called into JavaScript (route handlers, WebSocket events, etc.). */
+export function getCalledIntoJS() : number;
+
 /** WebSocket compression options. Combine any compressor with any decompressor using bitwise OR. */
 export type CompressOptions = number;
 /** No compression (always a good idea if you operate using an efficient binary protocol) */
@@ -23,10 +23,21 @@
 #include "akeno/App.h"
 #include <v8.h>
 #include "Utilities.h"
+#include "DeclarativeResponse.h"
+#include "CachedHttpResponse.h"
+#include "HttpValidators.h"
+#include "ByteRanges.h"
+#include "AsyncFile.h"
 #include <memory>
 #include <functional>
+#include <algorithm>
 #include <utility>
 #include <filesystem>
+#include <chrono>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 // todo
 #include "akeno/WebApp.h"
@@ -49,99 +60,140 @@ utf8(v8::Isolate* isolate, std::string_view sv) {
  * WARNING: the following code is mostly still a prototype.
  */
 
-/* Helper for query decoding for resolve() logic, when needed */
-std::string decodeURIComponent(std::string_view url) {
-    std::string decoded;
-    decoded.reserve(url.length());
-    for (size_t i = 0; i < url.length(); ++i) {
-        if (url[i] == '%' && i + 2 < url.length()) {
-            char key[3] = {url[i + 1], url[i + 2], '\0'};
-            char *end;
-            unsigned long value = strtoul(key, &end, 16);
-            if (end == key + 2) {
-                decoded += (char)value;
-                i += 2;
-            } else {
-                decoded += url[i];
+template <bool SSL>
+static inline void initReqResObjects(PerContextData *perContextData, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, Local<Object> *reqObjectOut, Local<Object> *resObjectOut) {
+    Isolate *isolate = perContextData->isolate;
+
+    Local<Object> reqObject = perContextData->reqTemplate[0].Get(isolate)->Clone();
+    reqObject->SetAlignedPointerInInternalField(0, req);
+
+    /* Properties like method, path or domain are lazy (see HttpRequestWrapper), we only store what they can't derive from req */
+    reqObject->SetAlignedPointerInInternalField(1, SSL ? (void *) &kSecureRequestTag : nullptr);
+
+    Local<Object> resObject = perContextData->resTemplate[SSL ? 1 : 0].Get(isolate)->Clone();
+    resObject->SetAlignedPointerInInternalField(0, res);
+
+    *reqObjectOut = reqObject;
+    *resObjectOut = resObject;
+}
+
+/* Same as initReqResObjects, but res is a CachedHttpResponse recording into cache under key */
+template <bool SSL>
+static inline CachedHttpResponse *initCachedReqResObjects(PerContextData *perContextData, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, const std::shared_ptr<ResponseCache> &cache, const std::string &key, Local<Object> *reqObjectOut, Local<Object> *resObjectOut) {
+    Isolate *isolate = perContextData->isolate;
+
+    Local<Object> reqObject = perContextData->reqTemplate[0].Get(isolate)->Clone();
+    reqObject->SetAlignedPointerInInternalField(0, req);
+    reqObject->SetAlignedPointerInInternalField(1, SSL ? (void *) &kSecureRequestTag : nullptr);
+
+    CachedHttpResponse *recorder = new CachedHttpResponse(res, SSL, cache, key);
+
+    Local<Object> resObject = perContextData->resTemplate[3].Get(isolate)->Clone();
+    resObject->SetAlignedPointerInInternalField(0, recorder);
+
+    *reqObjectOut = reqObject;
+    *resObjectOut = resObject;
+    return recorder;
+}
+
+/* The recorder of a response JS did not end synchronously lives until it ends or the request is aborted */
+template <bool SSL>
+static inline void keepCachedResObject(Isolate *isolate, uWS::HttpResponse<SSL> *res, CachedHttpResponse *recorder, Local<Object> resObject) {
+    UniquePersistent<Object> resObjectPersistent(isolate, resObject);
+
+    res->onAborted([recorder, resObject = std::move(resObjectPersistent), isolate]() {
+        HandleScope hs(isolate);
+
+        Local<Object>::New(isolate, resObject)->SetAlignedPointerInInternalField(0, nullptr);
+        recorder->aborted();
+    });
+}
+
+/* Takes the cache option of app.route, { ttl, query, vary }. Returns nullptr if there is none */
+static std::shared_ptr<ResponseCache> parseResponseCacheOptions(Isolate *isolate, Local<Value> options) {
+    if (!options->IsObject()) {
+        return nullptr;
+    }
+
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Object> optionsObject = Local<Object>::Cast(options);
+
+    auto getStrings = [&](const char *name) {
+        std::vector<std::string> strings;
+        MaybeLocal<Value> maybeArray = optionsObject->Get(context, String::NewFromUtf8(isolate, name, NewStringType::kNormal).ToLocalChecked());
+        if (!maybeArray.IsEmpty() && maybeArray.ToLocalChecked()->IsArray()) {
+            Local<Array> array = Local<Array>::Cast(maybeArray.ToLocalChecked());
+            for (uint32_t i = 0; i < array->Length(); i++) {
+                strings.push_back(*String::Utf8Value(isolate, array->Get(context, i).ToLocalChecked()));
             }
-        } else {
-            decoded += url[i];
         }
+        return strings;
+    };
+
+    int64_t ttl = 0;
+    MaybeLocal<Value> maybeTtl = optionsObject->Get(context, String::NewFromUtf8(isolate, "ttl", NewStringType::kNormal).ToLocalChecked());
+    if (!maybeTtl.IsEmpty()) {
+        ttl = maybeTtl.ToLocalChecked()->IntegerValue(context).FromMaybe(0);
     }
-    return decoded;
-}
 
-inline v8::Local<v8::String>
-oneByte(v8::Isolate* isolate, std::string_view sv) {
-    return v8::String::NewFromOneByte(
-        isolate,
-        reinterpret_cast<const uint8_t*>(sv.data()),
-        v8::NewStringType::kNormal,
-        static_cast<int>(sv.size())
-    ).ToLocalChecked();
+    if (ttl <= 0) {
+        return nullptr;
+    }
+
+    return std::make_shared<ResponseCache>(std::chrono::milliseconds(ttl), getStrings("query"), getStrings("vary"));
 }
 
-struct ReqKeys {
-    v8::Eternal<v8::String> method, origin, secure, host, domain, path, contentType, contentLength;
-};
+/* Pooled wrappers are only handed to routes that promise not to keep req/res past the handler return */
+constexpr size_t kMaxPooledObjects = 64;
 
-ReqKeys& getReqKeys(v8::Isolate* isolate);
+static inline Local<Object> takePooledObject(Isolate *isolate, std::vector<Global<Object>> &pool, Global<Object> &objectTemplate) {
+    if (pool.empty()) {
+        /* Properties added by one request would show up in the next one */
+        Local<Object> object = objectTemplate.Get(isolate)->Clone();
+        object->SetIntegrityLevel(isolate->GetCurrentContext(), IntegrityLevel::kSealed).IsNothing();
+        return object;
+    }
 
+    Local<Object> object = pool.back().Get(isolate);
+    pool.pop_back();
+    return object;
+}
+
+/* Same as initReqResObjects, but takes the objects from the per-isolate pool when possible */
 template <bool SSL>
-static inline void initReqResObjects(PerContextData *perContextData, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, Local<Object> *reqObjectOut, Local<Object> *resObjectOut) {
+static inline void acquireReqResObjects(PerContextData *perContextData, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, Local<Object> *reqObjectOut, Local<Object> *resObjectOut) {
     Isolate *isolate = perContextData->isolate;
-    Local<Context> context = isolate->GetCurrentContext();
 
-    Local<Object> reqObject = perContextData->reqTemplate[0].Get(isolate)->Clone();
+    Local<Object> reqObject = takePooledObject(isolate, perContextData->reqPool, perContextData->pooledReqTemplate);
     reqObject->SetAlignedPointerInInternalField(0, req);
+    reqObject->SetAlignedPointerInInternalField(1, SSL ? (void *) &kSecureRequestTag : nullptr);
 
-    Local<Object> resObject = perContextData->resTemplate[SSL ? 1 : 0].Get(isolate)->Clone();
+    Local<Object> resObject = takePooledObject(isolate, perContextData->resPool[SSL], perContextData->resTemplate[SSL ? 1 : 0]);
     resObject->SetAlignedPointerInInternalField(0, res);
 
-    std::string_view method = req->getCaseSensitiveMethod();
-    std::string_view url = req->getUrl();
-    std::string_view host = req->getHeader("host");
-    std::string_view domain = host;
-    size_t colonPos = host.find(':');
-    if (colonPos != std::string_view::npos) {
-        domain = host.substr(0, colonPos);
-    }
-
-    ReqKeys &keys = getReqKeys(isolate);
-
-    std::string_view origin = req->getHeader("origin");
-    reqObject->Set(context, keys.method.Get(isolate), oneByte(isolate, method)).Check();
-    reqObject->Set(context, keys.origin.Get(isolate), oneByte(isolate, origin)).Check();
-    reqObject->Set(context, keys.secure.Get(isolate), Boolean::New(isolate, SSL)).Check();
-    reqObject->Set(context, keys.host.Get(isolate), oneByte(isolate, host)).Check();
-    reqObject->Set(context, keys.domain.Get(isolate), oneByte(isolate, domain)).Check();
-
-    if (url.find('%') != std::string_view::npos) {
-        std::string decoded = decodeURIComponent(url);
-        reqObject->Set(context, keys.path.Get(isolate),
-                    oneByte(isolate, decoded))
-            .Check();
-    } else {
-        reqObject->Set(context, keys.path.Get(isolate),
-                    oneByte(isolate, url))
-            .Check();
-    }
+    *reqObjectOut = reqObject;
+    *resObjectOut = resObject;
+}
 
-    if (method == "POST" ||
-        method == "PUT" ||
-        method == "PATCH" ||
-        method == "DELETE") {
-        std::string_view ct = req->getHeader("content-type");
-        reqObject->Set(context, keys.contentType.Get(isolate),
-            oneByte(isolate, ct)).Check();
+/* Returns the objects to the pool after the handler returned. The request is invalid by now, the response
+ * is only reused if it was ended and no native callback (onAborted, onWritable, onData) still refers to it.
+ * Neither is reused when the handler returned a promise, the request then keeps a snapshot of its properties */
+template <bool SSL>
+static inline void releaseReqResObjects(PerContextData *perContextData, Local<Object> reqObject, Local<Object> resObject, MaybeLocal<Value> returned) {
+    Isolate *isolate = perContextData->isolate;
 
-        std::string_view cl = req->getHeader("content-length");
-        reqObject->Set(context, keys.contentLength.Get(isolate),
-            oneByte(isolate, cl)).Check();
+    if (!returned.IsEmpty() && returned.ToLocalChecked()->IsPromise()) {
+        return;
     }
 
-    *reqObjectOut = reqObject;
-    *resObjectOut = resObject;
+    if (perContextData->reqPool.size() < kMaxPooledObjects) {
+        perContextData->reqPool.emplace_back(isolate, reqObject);
+    }
+
+    if (!resObject->GetAlignedPointerFromInternalField(0) && !resObject->GetAlignedPointerFromInternalField(1) &&
+        perContextData->resPool[SSL].size() < kMaxPooledObjects) {
+        perContextData->resPool[SSL].emplace_back(isolate, resObject);
+    }
 }
 
 /* App wrapper functions — protocol-agnostic */
@@ -172,9 +224,42 @@ void uWS_App_route(const FunctionCallbackInfo<Value> &args) {
         return;
     }
 
+    /* options: { pooled } - the handler never keeps req/res after it returns, so their wrappers can be reused */
+    /* options: { cache: { ttl, query, vary } } - responses of a function handler are reused for ttl ms */
+    bool pooled = false;
+    std::shared_ptr<ResponseCache> cache;
+    if (args.Length() > 2 && args[2]->IsObject()) {
+        MaybeLocal<Value> maybePooled = Local<Object>::Cast(args[2])->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "pooled", NewStringType::kNormal).ToLocalChecked());
+        if (!maybePooled.IsEmpty()) {
+            pooled = maybePooled.ToLocalChecked()->BooleanValue(isolate);
+        }
+
+        MaybeLocal<Value> maybeCache = Local<Object>::Cast(args[2])->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "cache", NewStringType::kNormal).ToLocalChecked());
+        if (!maybeCache.IsEmpty()) {
+            cache = parseResponseCacheOptions(isolate, maybeCache.ToLocalChecked());
+        }
+    }
+
     DomainHandler handler;
 
-    // TODO: Support DeclarativeResponse
+    /* DeclarativeResponse programs (tagged by uws.js) are executed natively */
+    if (args[1]->IsArrayBuffer() && Local<Object>::Cast(args[1])->Has(isolate->GetCurrentContext(), Symbol::For(isolate, String::NewFromUtf8(isolate, "uWS.DeclarativeResponse", NewStringType::kNormal).ToLocalChecked())).FromMaybe(false)) {
+        NativeString program(isolate, args[1]);
+        if (program.isInvalid(args)) {
+            return;
+        }
+
+        std::shared_ptr<DeclarativeProgram> parsedProgram = DeclarativeProgram::parse(program.getString());
+        if (!parsedProgram) {
+            args.GetReturnValue().Set(isolate->ThrowException(v8::Exception::Error(String::NewFromUtf8(isolate, "Malformed DeclarativeResponse.", NewStringType::kNormal).ToLocalChecked())));
+            return;
+        }
+
+        app->route(patternStr, DeclarativeProgram::toDomainHandler(std::move(parsedProgram)));
+        args.GetReturnValue().Set(args.This());
+        return;
+    }
+
     if (args[1]->IsArrayBuffer()) {
         NativeString staticBuf(isolate, args[1]);
         if (staticBuf.isInvalid(args)) {
@@ -203,20 +288,49 @@ void uWS_App_route(const FunctionCallbackInfo<Value> &args) {
         // TODO: Optimize calls
 
         // Create a unified template lambda that works with both HTTP and HTTPS (C++20)
-        auto sharedHandler = [cbPtr, perContextData]<bool SSL>(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req) {
+        auto sharedHandler = [cbPtr, perContextData, pooled, cache]<bool SSL>(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req) {
+            /* Fresh cache hits never enter JS. Only GET requests are cached, anything else always reaches the handler */
+            thread_local std::string cacheKey;
+            bool caching = cache && req->getCaseSensitiveMethod() == "GET" && !cache->bypasses(req);
+            if (caching) {
+                cache->makeKey(cacheKey, req);
+                if (cache->tryServe(res, cacheKey)) {
+                    return;
+                }
+            }
+
             Isolate *isolate = perContextData->isolate;
             HandleScope hs(isolate);
             Local<Object> reqObject;
             Local<Object> resObject;
-            initReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            CachedHttpResponse *recorder = nullptr;
+            if (caching) {
+                /* Recording responses are not pooled */
+                recorder = initCachedReqResObjects<SSL>(perContextData, res, req, cache, cacheKey, &reqObject, &resObject);
+            } else if (pooled) {
+                acquireReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            } else {
+                initReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            }
 
             // IMPORTANT NOTE: We switched to the more common order "req, res" in contrast to the reverse order that µWS uses.
             // This is to align with how most other frameworks work, but it is something to keep in mind - Akeno-uWS differs from the uWS API.
             Local<Value> argv[] = {reqObject, resObject};
-            CallJS(isolate, cbPtr->Get(isolate), 2, argv);
+            MaybeLocal<Value> returned = CallJS(isolate, cbPtr->Get(isolate), 2, argv);
+
+            /* Async handlers may still read the request properties after an await */
+            if (!returned.IsEmpty() && returned.ToLocalChecked()->IsPromise()) {
+                HttpRequestWrapper::materialize(isolate, reqObject, pooled);
+            }
 
             // Invalidate request
             reqObject->SetAlignedPointerInInternalField(0, nullptr);
+
+            if (recorder && resObject->GetAlignedPointerFromInternalField(0)) {
+                keepCachedResObject<SSL>(isolate, res, recorder, resObject);
+            } else if (pooled) {
+                releaseReqResObjects<SSL>(perContextData, reqObject, resObject, returned);
+            }
         };
 
         // Instantiate the template lambda for both HTTP and HTTPS
@@ -267,7 +381,7 @@ void uWS_App_route(const FunctionCallbackInfo<Value> &args) {
         auto objectPtr = std::make_shared<Global<Object>>();
         objectPtr->Reset(isolate, Local<Object>::Cast(args[1]));
 
-        auto sharedHandler = [objectPtr, callbackPtr, perContextData]<bool SSL>(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req) {
+        auto sharedHandler = [objectPtr, callbackPtr, perContextData, pooled]<bool SSL>(uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req) {
             if (!callbackPtr || callbackPtr->IsEmpty()) {
                 res->end();
                 return;
@@ -277,13 +391,25 @@ void uWS_App_route(const FunctionCallbackInfo<Value> &args) {
             HandleScope hs(isolate);
             Local<Object> reqObject;
             Local<Object> resObject;
-            initReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            if (pooled) {
+                acquireReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            } else {
+                initReqResObjects<SSL>(perContextData, res, req, &reqObject, &resObject);
+            }
             Local<Function> onObjectLf = Local<Function>::New(isolate, *callbackPtr);
             Local<Object> objectValue = Local<Object>::New(isolate, *objectPtr);
             Local<Value> argv[] = {reqObject, resObject, objectValue};
-            CallJS(isolate, onObjectLf, 3, argv);
+            MaybeLocal<Value> returned = CallJS(isolate, onObjectLf, 3, argv);
+
+            if (!returned.IsEmpty() && returned.ToLocalChecked()->IsPromise()) {
+                HttpRequestWrapper::materialize(isolate, reqObject, pooled);
+            }
 
             reqObject->SetAlignedPointerInInternalField(0, nullptr);
+
+            if (pooled) {
+                releaseReqResObjects<SSL>(perContextData, reqObject, resObject, returned);
+            }
         };
 
         handler = DomainHandler::onRequestBoth(
@@ -304,6 +430,207 @@ void uWS_App_route(const FunctionCallbackInfo<Value> &args) {
     args.GetReturnValue().Set(args.This());
 }
 
+static inline std::string getFileProcessKey(Akeno::WebApp *webApp, std::string_view fullPath) {
+    std::string key((const char *) &webApp, sizeof(webApp));
+    key.append(fullPath);
+    return key;
+}
+
+/* Returns the id of the processing job for this file, creating it if there is none yet (isFirst) */
+static std::pair<uint64_t, bool> findOrCreateFileProcess(PerContextData *perContextData, Akeno::WebApp *webApp, std::string_view url, std::string_view fullPath, std::string_view mimeType) {
+    auto [idIt, isFirst] = perContextData->pendingFileProcessIds.try_emplace(getFileProcessKey(webApp, fullPath), perContextData->nextFileProcessId);
+    uint64_t id = idIt->second;
+
+    if (isFirst) {
+        perContextData->nextFileProcessId++;
+
+        PerContextData::PendingFileProcess pending;
+        pending.webApp = webApp;
+        pending.url.assign(url.data(), url.size());
+        pending.fullPath.assign(fullPath.data(), fullPath.size());
+        pending.mimeType.assign(mimeType.data(), mimeType.size());
+        perContextData->pendingFileProcesses.emplace(id, std::move(pending));
+    }
+
+    return {id, isFirst};
+}
+
+/* Takes a job out of the pending maps, later misses for the file start a new one */
+static PerContextData::PendingFileProcess takeFileProcess(PerContextData *perContextData, decltype(PerContextData::pendingFileProcesses)::iterator it) {
+    PerContextData::PendingFileProcess pending = std::move(it->second);
+    perContextData->pendingFileProcesses.erase(it);
+    perContextData->pendingFileProcessIds.erase(getFileProcessKey(pending.webApp, pending.fullPath));
+    return pending;
+}
+
+/* Answers every request waiting on a job that failed */
+static void failPendingRequests(PerContextData::PendingFileProcess &pending) {
+    for (PerContextData::PendingFileRequest &request : pending.requests) {
+        if (!request.res) {
+            continue;
+        }
+
+        if (request.ssl) {
+            ((uWS::HttpResponse<true> *) request.res)->writeStatus("500 Internal Server Error")->end();
+        } else {
+            ((uWS::HttpResponse<false> *) request.res)->writeStatus("500 Internal Server Error")->end();
+        }
+        request.res = nullptr;
+    }
+}
+
+/* A processor that threw won't complete the job, its requests fail right away instead of waiting on it */
+static void callFileProcessor(PerContextData *perContextData, uint64_t id, std::string_view url, std::string_view fullPath, std::string_view mimeType) {
+    Isolate *isolate = perContextData->isolate;
+    HandleScope hs(isolate);
+    Local<Function> cb = Local<Function>::New(isolate, *perContextData->fileProcessorCallback);
+    Local<Value> argv[] = {Number::New(isolate, (double) id), utf8(isolate, url), utf8(isolate, fullPath), utf8(isolate, mimeType)};
+    if (CallJS(isolate, cb, 4, argv).IsEmpty()) {
+        auto it = perContextData->pendingFileProcesses.find(id);
+        if (it != perContextData->pendingFileProcesses.end() && !it->second.reading) {
+            PerContextData::PendingFileProcess pending = takeFileProcess(perContextData, it);
+            failPendingRequests(pending);
+        }
+    }
+}
+
+/* Hands a file cache miss to the file processor. Returns false if there is none.
+ * Only the first miss for a file calls into JS, the rest are answered by the same completeProcessing */
+template <bool SSL>
+static bool startFileProcess(PerContextData *perContextData, Akeno::WebApp *webApp, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req, std::string_view url, std::string_view fullPath, std::string_view mimeType, int variant, std::string_view status) {
+    if (!perContextData->fileProcessorCallback || perContextData->fileProcessorCallback->IsEmpty()) {
+        return false;
+    }
+
+    auto [id, isFirst] = findOrCreateFileProcess(perContextData, webApp, url, fullPath, mimeType);
+
+    WebAppCache &cache = perContextData->webAppCaches[webApp];
+    (isFirst ? cache.misses : cache.coalesced)++;
+
+    auto &requests = perContextData->pendingFileProcesses[id].requests;
+    size_t index = requests.size();
+    requests.push_back({SSL, res, std::string(status), variant, std::string(req->getHeader("if-none-match")), std::string(req->getHeader("if-modified-since")),
+        std::string(req->getHeader("range")), std::string(req->getHeader("if-range")), std::string(req->getHeader("accept-encoding"))});
+
+    /* The job stays while others wait on it, its result still goes to the cache. Once nobody waits it is dropped,
+     * so a processor that never completes holds requests only until they time out, the next miss starts over */
+    res->onAborted([perContextData, id, index]() {
+        auto it = perContextData->pendingFileProcesses.find(id);
+        if (it == perContextData->pendingFileProcesses.end()) {
+            return;
+        }
+
+        std::vector<PerContextData::PendingFileRequest> &requests = it->second.requests;
+        requests[index].res = nullptr;
+        if (!it->second.reading && std::none_of(requests.begin(), requests.end(), [](const PerContextData::PendingFileRequest &request) { return request.res; })) {
+            takeFileProcess(perContextData, it);
+        }
+    });
+
+    if (isFirst) {
+        callFileProcessor(perContextData, id, url, fullPath, mimeType);
+    }
+    return true;
+}
+
+/* Processor paths may be relative to the WebApp root, the cache key stays as given */
+static std::string resolveProcessedPath(Akeno::WebApp *webApp, const std::string &fullPath) {
+    std::filesystem::path path(fullPath);
+    if (path.is_relative()) {
+        path = std::filesystem::path(webApp->root) / path;
+    }
+    return path.lexically_normal().string();
+}
+
+/* Makes dependent redo its work when path changes. Returns false if path can't be watched */
+static bool addFileDependent(PerContextData *perContextData, const std::string &path, PerContextData::FileDependent dependent) {
+    std::string normalizedPath = FileWatcher::normalize(path);
+    if (!perContextData->fileWatcher.watch(node::GetCurrentEventLoop(perContextData->isolate), normalizedPath)) {
+        return false;
+    }
+
+    std::vector<PerContextData::FileDependent> &dependents = perContextData->fileDependents[normalizedPath];
+    for (const PerContextData::FileDependent &existing : dependents) {
+        if (existing.webApp == dependent.webApp && existing.changed == dependent.changed && existing.fullPath == dependent.fullPath) {
+            return true;
+        }
+    }
+    dependents.push_back(std::move(dependent));
+    return true;
+}
+
+/* Processes a stale WebApp file again (running compression jobs dropped, the variants stay until the new content
+ * turns out to differ). A file that is gone takes its validator and variants along, the processor still decides
+ * what happens next */
+static void refreshStaleFile(PerContextData *perContextData, PerContextData::FileDependent &&dependent) {
+    uv_loop_t *loop = node::GetCurrentEventLoop(perContextData->isolate);
+    std::string path = resolveProcessedPath(dependent.webApp, dependent.fullPath);
+    AsyncFile::stat(loop, path, [perContextData, dependent = std::move(dependent)](const uv_stat_t *stat) {
+        WebAppCache &cache = perContextData->webAppCaches[dependent.webApp];
+        if (!stat) {
+            cache.forget(dependent.fullPath);
+        }
+        cache.generations.erase(dependent.fullPath);
+
+        if (!perContextData->fileProcessorCallback || perContextData->fileProcessorCallback->IsEmpty()) {
+            return;
+        }
+
+        auto [id, isFirst] = findOrCreateFileProcess(perContextData, dependent.webApp, dependent.url, dependent.fullPath, dependent.mimeType);
+        if (isFirst) {
+            callFileProcessor(perContextData, id, dependent.url, dependent.fullPath, dependent.mimeType);
+        }
+    });
+}
+
+/* Called by the file watcher. HTMLParser files are marked so needsUpdate reports them. WebApp files are marked stale
+ * and processed again once changes settle: a deploy or a save touches many files and each shared include has
+ * many dependents, those are all handled in one go kStaleFilesDelay ms after the first change */
+static constexpr uint64_t kStaleFilesDelay = 50;
+
+static void invalidateFile(PerContextData *perContextData, const std::string &path) {
+    auto it = perContextData->fileDependents.find(path);
+    if (it == perContextData->fileDependents.end()) {
+        return;
+    }
+
+    std::vector<PerContextData::FileDependent> dependents = std::move(it->second);
+    perContextData->fileDependents.erase(it);
+
+    for (PerContextData::FileDependent &dependent : dependents) {
+        if (dependent.changed) {
+            dependent.changed->insert(dependent.fullPath);
+            continue;
+        }
+
+        std::string key = getFileProcessKey(dependent.webApp, dependent.fullPath);
+        perContextData->staleFiles.try_emplace(std::move(key), std::move(dependent));
+    }
+
+    if (perContextData->staleFiles.empty()) {
+        return;
+    }
+
+    if (!perContextData->staleFilesTimer) {
+        perContextData->staleFilesTimer = new uv_timer_t;
+        perContextData->staleFilesTimer->data = perContextData;
+        uv_timer_init(node::GetCurrentEventLoop(perContextData->isolate), perContextData->staleFilesTimer);
+        /* A pending refresh never keeps the process alive */
+        uv_unref((uv_handle_t *) perContextData->staleFilesTimer);
+    }
+
+    if (!uv_is_active((uv_handle_t *) perContextData->staleFilesTimer)) {
+        uv_timer_start(perContextData->staleFilesTimer, [](uv_timer_t *timer) {
+            PerContextData *perContextData = (PerContextData *) timer->data;
+            auto staleFiles = std::move(perContextData->staleFiles);
+            perContextData->staleFiles.clear();
+            for (auto &[key, dependent] : staleFiles) {
+                refreshStaleFile(perContextData, std::move(dependent));
+            }
+        }, kStaleFilesDelay, 0);
+    }
+}
+
 /* app.registerFileProcessor(cb) — cb(id, url, path) */
 void uWS_App_registerFileProcessor(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
@@ -363,8 +690,173 @@ static inline bool extractBufferToString(Isolate *isolate, const Local<Value> &v
     return false;
 }
 
-/* app.completeProcessing(id, result, [linkedPaths]) */
-// TODO: We could respond to all pending requests to avoid duplicate work
+/* If-None-Match uses the weak comparison against the ETag of the representation the request would get,
+ * and wins over If-Modified-Since (RFC 9110 13.2.2) */
+static bool isNotModified(const PerContextData::PendingFileRequest &request, const WebAppCache::Validator &validator, std::string_view etag) {
+    if (request.ifNoneMatch.length()) {
+        return etagListMatches(request.ifNoneMatch, etag.starts_with("W/") ? etag.substr(2) : etag);
+    }
+
+    if (request.ifModifiedSince.length()) {
+        int64_t since = parseHttpDate(request.ifModifiedSince);
+        return since >= 0 && validator.lastModified <= since;
+    }
+    return false;
+}
+
+/* Replaces the variants of a file that just got updated. Until its job finishes, the file has identity only */
+static void schedulePrecompression(PerContextData *perContextData, Akeno::WebApp *webApp, WebAppCache &cache, const std::string &fullPath, std::shared_ptr<const std::string> data) {
+    cache.eraseVariants(fullPath);
+
+    if (!data) {
+        cache.generations.erase(fullPath);
+        return;
+    }
+
+    uint64_t generation = cache.nextGeneration++;
+    cache.generations[fullPath] = generation;
+
+    perContextData->precompressionPool.push({std::move(data), cache.precompress, [perContextData, webApp, fullPath, generation](PrecompressedVariants &&variants) {
+        auto it = perContextData->webAppCaches.find(webApp);
+        if (it == perContextData->webAppCaches.end()) {
+            return;
+        }
+        auto generationIt = it->second.generations.find(fullPath);
+        if (generationIt == it->second.generations.end() || generationIt->second != generation) {
+            return;
+        }
+        it->second.generations.erase(generationIt);
+        it->second.setVariants(fullPath, std::make_shared<const PrecompressedVariants>(std::move(variants)));
+    }});
+}
+
+/* Caches the result of a job and answers every request waiting on it */
+static void finishFileProcess(PerContextData *perContextData, PerContextData::PendingFileProcess &pending, std::string &&buffer, std::vector<std::string> &&linkedPaths, const std::string &mimeType) {
+    WebAppCache &cache = perContextData->webAppCaches[pending.webApp];
+    cache.updates++;
+
+    /* Reprocessing the same content keeps the validator, so clients holding it still get 304s */
+    std::string etag = makeETag(buffer);
+    WebAppCache::Validator &validator = cache.validators[pending.fullPath];
+    bool changed = validator.etag != etag;
+    if (changed) {
+        validator.etag = std::move(etag);
+        validator.lastModified = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        validator.lastModifiedHeader = formatHttpDate(validator.lastModified);
+    }
+    WebAppCache::Validator fileValidator = validator;
+
+    /* The cache takes the buffer, compression workers get their own copy. Unchanged content keeps its variants */
+    bool recompress = changed || !cache.variants.contains(pending.fullPath);
+    std::shared_ptr<const std::string> precompressData;
+    if (recompress && cache.precompress.enabled && buffer.length() >= cache.precompress.minSize) {
+        precompressData = std::make_shared<const std::string>(buffer);
+    }
+
+    /* Range requests are answered from the identity content, which the cache is about to take */
+    std::string rangeSource;
+    for (PerContextData::PendingFileRequest &request : pending.requests) {
+        if (request.res && request.range.length()) {
+            rangeSource = buffer;
+            break;
+        }
+    }
+
+    linkedPaths.emplace_back(pending.fullPath);
+    Akeno::FileCache::CacheEntry* entry = pending.webApp->fileCache.update(pending.fullPath, std::move(buffer), linkedPaths, mimeType);
+
+    if (recompress) {
+        schedulePrecompression(perContextData, pending.webApp, cache, pending.fullPath, std::move(precompressData));
+    }
+    std::shared_ptr<const PrecompressedVariants> fileVariants = cache.get(pending.fullPath);
+
+    /* Changes to the file or anything it was built from refresh it, linkedPaths ends with the file itself */
+    for (const std::string &linkedPath : linkedPaths) {
+        addFileDependent(perContextData, resolveProcessedPath(pending.webApp, linkedPath), {pending.webApp, nullptr, pending.fullPath, pending.url, mimeType});
+    }
+
+    // Now finally try to respond to the pending requests, aborted ones only leave the cache behind
+    auto respond = [&](auto *res, PerContextData::PendingFileRequest &request) {
+        /* A precompressed variant the client accepts, FileCache compresses on its own otherwise */
+        std::string_view encoding;
+        std::string_view variantBody = fileVariants ? fileVariants->select(request.acceptEncoding, encoding) : std::string_view();
+
+        /* Byte ranges are only valid within one coding, so a variant gets its own strong ETag. What FileCache may
+         * compress gets a weak one, which If-Range never matches */
+        std::string etag = variantBody.length() ? makeEncodedETag(fileValidator.etag, encoding)
+            : PrecompressedVariants::acceptsAny(request.acceptEncoding) ? "W/" + fileValidator.etag : fileValidator.etag;
+
+        auto serve = [&](std::string_view status, bool statusWritten) {
+            if (variantBody.length()) {
+                cache.variantHits++;
+                if (!statusWritten) {
+                    res->writeStatus(status);
+                }
+                res->writeHeader("Content-Type", mimeType)
+                    ->writeHeader("Content-Encoding", encoding)
+                    ->writeHeader("Vary", "Accept-Encoding")
+                    ->end(variantBody);
+                return;
+            }
+            if (!pending.webApp->fileCache.tryServeWithCompression(pending.fullPath, request.variant, res, status)) {
+                res->end();
+            }
+        };
+
+        /* Error pages are served with their own status and never revalidated */
+        if (request.status.length() && request.status[0] != '2') {
+            serve(request.status, false);
+            return;
+        }
+
+        if (isNotModified(request, fileValidator, etag)) {
+            cache.notModified++;
+            res->writeStatus("304 Not Modified")
+                ->writeHeader("ETag", etag)
+                ->writeHeader("Last-Modified", fileValidator.lastModifiedHeader)
+                ->endWithoutBody();
+            return;
+        }
+
+        if (request.range.length()) {
+            ByteRanges ranges(ifRangeMatches(request.ifRange, fileValidator.etag, fileValidator.lastModified) ? std::string_view(request.range) : std::string_view(), rangeSource.length(), mimeType);
+            if (ranges.result == ByteRanges::UNSATISFIABLE) {
+                ranges.endUnsatisfiable(res);
+                return;
+            }
+            if (ranges.result == ByteRanges::PARTIAL) {
+                res->writeStatus("206 Partial Content")
+                    ->writeHeader("ETag", fileValidator.etag)
+                    ->writeHeader("Last-Modified", fileValidator.lastModifiedHeader);
+                ranges.endFromBuffer(res, rangeSource);
+                return;
+            }
+        }
+
+        /* The status goes first so the headers can follow, FileCache won't write another one */
+        res->writeStatus(request.status.length() ? request.status : "200 OK")
+            ->writeHeader("ETag", etag)
+            ->writeHeader("Last-Modified", fileValidator.lastModifiedHeader);
+        serve(request.status, true);
+    };
+
+    for (PerContextData::PendingFileRequest &request : pending.requests) {
+        if (!request.res) {
+            continue;
+        }
+
+        /* We may run from a libuv callback, outside of any cork */
+        if (request.ssl) {
+            auto *res = (uWS::HttpResponse<true> *) request.res;
+            res->cork([&]() { respond(res, request); });
+        } else {
+            auto *res = (uWS::HttpResponse<false> *) request.res;
+            res->cork([&]() { respond(res, request); });
+        }
+    }
+}
+
+/* app.completeProcessing(id, result, [linkedPaths]) - result is the processed file, or true to serve it unchanged. Responds to every request waiting for this file */
 // TODO: Pass the WebApp object if possible
 void uWS_App_completeProcessing(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
@@ -377,30 +869,17 @@ void uWS_App_completeProcessing(const FunctionCallbackInfo<Value> &args) {
 
     uint64_t id = (uint64_t) args[0]->IntegerValue(isolate->GetCurrentContext()).ToChecked();
     auto it = perContextData->pendingFileProcesses.find(id);
-    if (it == perContextData->pendingFileProcesses.end()) {
+    if (it == perContextData->pendingFileProcesses.end() || it->second.reading) {
         args.GetReturnValue().Set(Boolean::New(isolate, false));
         return;
     }
 
-    PerContextData::PendingFileProcess pending = std::move(it->second);
-    perContextData->pendingFileProcesses.erase(it);
-
-    if (!pending.webApp) {
+    if (!it->second.webApp) {
+        takeFileProcess(perContextData, it);
         args.GetReturnValue().Set(Boolean::New(isolate, false));
         return;
     }
 
-    // TODO: if buffer is "true", we shuold read the file directly (no processing done from JS)
-    // As of now JS always sends the file buffer which is inefficient (though only done for the first request)
-    // Problem is path handling which will be resolved later at some point but currently causes issues
-
-    std::string buffer;
-    if (!extractBufferToString(isolate, args[1], &buffer)) {
-        args.GetReturnValue().Set(isolate->ThrowException(v8::Exception::Error(
-            String::NewFromUtf8(isolate, "completeProcessing() requires result as String/ArrayBuffer/TypedArray", NewStringType::kNormal).ToLocalChecked())));
-        return;
-    }
-
     std::vector<std::string> linkedPaths;
     if (args.Length() > 2 && args[2]->IsArray()) {
         Local<Array> arr = Local<Array>::Cast(args[2]);
@@ -417,7 +896,7 @@ void uWS_App_completeProcessing(const FunctionCallbackInfo<Value> &args) {
         }
     }
 
-    std::string mimeType = pending.mimeType;
+    std::string mimeType = it->second.mimeType;
     if (args.Length() > 3 && args[3]->IsString()) {
         v8::String::Utf8Value mt(isolate, args[3]);
         if (*mt && mt.length() > 0) {
@@ -425,34 +904,46 @@ void uWS_App_completeProcessing(const FunctionCallbackInfo<Value> &args) {
         }
     }
 
-    linkedPaths.emplace_back(pending.fullPath);
-    Akeno::FileCache::CacheEntry* entry = pending.webApp->fileCache.update(pending.fullPath, std::move(buffer), linkedPaths, mimeType);
+    /* true means the file needs no processing, we read it ourselves instead of copying it out of JS.
+     * The read is asynchronous, the job stays pending meanwhile so more misses for the file keep joining it */
+    if (args[1]->IsTrue()) {
+        it->second.reading = true;
+        AsyncFile::readAll(node::GetCurrentEventLoop(isolate), resolveProcessedPath(it->second.webApp, it->second.fullPath),
+            [perContextData, id, linkedPaths = std::move(linkedPaths), mimeType = std::move(mimeType)](bool ok, std::string &&buffer) mutable {
+                auto it = perContextData->pendingFileProcesses.find(id);
+                if (it == perContextData->pendingFileProcesses.end()) {
+                    return;
+                }
+
+                PerContextData::PendingFileProcess pending = takeFileProcess(perContextData, it);
+                if (!ok) {
+                    perContextData->webAppCaches[pending.webApp].forget(pending.fullPath);
+                    failPendingRequests(pending);
+                    return;
+                }
+                finishFileProcess(perContextData, pending, std::move(buffer), std::move(linkedPaths), mimeType);
+            });
 
-    if(!pending.res) {
-        // Request was aborted, but we can still store cache for future requests
         args.GetReturnValue().Set(Boolean::New(isolate, true));
         return;
     }
 
-    // Now finally try to respond to the pending request
-    // TODO: We *could* try to send a 304 but this is enough and more reliable+ we shouldn't rely on req here
-    if (pending.ssl) {
-        auto *res = (uWS::HttpResponse<true> *) pending.res;
-        if (!pending.webApp->fileCache.tryServeWithCompression(pending.fullPath, pending.variant, res, pending.status)) {
-            res->end();
-        }
-    } else {
-        auto *res = (uWS::HttpResponse<false> *) pending.res;
-        if (!pending.webApp->fileCache.tryServeWithCompression(pending.fullPath, pending.variant, res, pending.status)) {
-            res->end();
-        }
+    PerContextData::PendingFileProcess pending = takeFileProcess(perContextData, it);
+
+    std::string buffer;
+    if (!extractBufferToString(isolate, args[1], &buffer)) {
+        failPendingRequests(pending);
+        args.GetReturnValue().Set(isolate->ThrowException(v8::Exception::Error(
+            String::NewFromUtf8(isolate, "completeProcessing() requires result as String/ArrayBuffer/TypedArray", NewStringType::kNormal).ToLocalChecked())));
+        return;
     }
 
+    finishFileProcess(perContextData, pending, std::move(buffer), std::move(linkedPaths), mimeType);
     args.GetReturnValue().Set(Boolean::New(isolate, true));
 }
 
 // Shared helper to parse options and applying them to a WebApp instance
-void configureWebApp(Isolate *isolate, Akeno::WebApp *webApp, Local<Object> optionsObject) {
+void configureWebApp(Isolate *isolate, PerContextData *perContextData, Akeno::WebApp *webApp, Local<Object> optionsObject) {
     Local<Context> context = isolate->GetCurrentContext();
 
     // browserCompatibility: [int, int, bool]
@@ -485,6 +976,31 @@ void configureWebApp(Isolate *isolate, Akeno::WebApp *webApp, Local<Object> opti
     if (!maybeRedirect.IsEmpty() && !maybeRedirect.ToLocalChecked()->IsUndefined()) {
         webApp->options.redirectToHttps = maybeRedirect.ToLocalChecked()->BooleanValue(isolate);
     }
+
+    // precompress: bool | { gzip, brotli, zstd, minSize, maxBytes }
+    MaybeLocal<Value> maybePrecompress = optionsObject->Get(context, String::NewFromUtf8(isolate, "precompress", NewStringType::kNormal).ToLocalChecked());
+    if (!maybePrecompress.IsEmpty() && !maybePrecompress.ToLocalChecked()->IsUndefined()) {
+        Local<Value> precompressValue = maybePrecompress.ToLocalChecked();
+        WebAppCache &cache = perContextData->webAppCaches[webApp];
+        PrecompressOptions &precompress = cache.precompress;
+        precompress.enabled = precompressValue->BooleanValue(isolate);
+
+        if (precompressValue->IsObject()) {
+            Local<Object> precompressObject = Local<Object>::Cast(precompressValue);
+            auto readInteger = [&](const char *name, auto &out) {
+                MaybeLocal<Value> maybeValue = precompressObject->Get(context, String::NewFromUtf8(isolate, name, NewStringType::kNormal).ToLocalChecked());
+                if (!maybeValue.IsEmpty() && maybeValue.ToLocalChecked()->IsNumber()) {
+                    out = (std::remove_reference_t<decltype(out)>) maybeValue.ToLocalChecked()->IntegerValue(context).FromMaybe(0);
+                }
+            };
+            readInteger("gzip", precompress.gzip);
+            readInteger("brotli", precompress.brotli);
+            readInteger("zstd", precompress.zstd);
+            readInteger("minSize", precompress.minSize);
+            readInteger("maxBytes", cache.maxBytes);
+            cache.shrinkTo(cache.maxBytes);
+        }
+    }
 }
 
 void uWS_WebApp_setOptions(const FunctionCallbackInfo<Value> &args) {
@@ -511,11 +1027,43 @@ void uWS_WebApp_setOptions(const FunctionCallbackInfo<Value> &args) {
         return;
     }
 
-    configureWebApp(isolate, webApp, Local<Object>::Cast(args[0]));
+    configureWebApp(isolate, (PerContextData *) Local<External>::Cast(args.Data())->Value(), webApp, Local<Object>::Cast(args[0]));
 
     args.GetReturnValue().Set(args.This());
 }
 
+/* Takes nothing, returns the counters of what the addon keeps for this WebApp. FileCache serves its hits without
+ * calling out, so only misses, variant hits and 304s show up here */
+void uWS_WebApp_cacheStats(const FunctionCallbackInfo<Value> &args) {
+    Isolate *isolate = args.GetIsolate();
+    Local<Context> context = isolate->GetCurrentContext();
+    auto *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+
+    Akeno::WebApp *webApp = (Akeno::WebApp *) args.This()->GetAlignedPointerFromInternalField(0);
+    if (!webApp) {
+        return;
+    }
+
+    WebAppCache &cache = perContextData->webAppCaches[webApp];
+
+    Local<Object> stats = Object::New(isolate);
+    auto set = [&](const char *name, double value) {
+        stats->Set(context, String::NewFromUtf8(isolate, name, NewStringType::kInternalized).ToLocalChecked(), Number::New(isolate, value)).ToChecked();
+    };
+    set("misses", (double) cache.misses);
+    set("coalesced", (double) cache.coalesced);
+    set("updates", (double) cache.updates);
+    set("variantHits", (double) cache.variantHits);
+    set("notModified", (double) cache.notModified);
+    set("evictions", (double) cache.budget.evictions);
+    set("files", (double) cache.validators.size());
+    set("variants", (double) cache.variants.size());
+    set("variantBytes", (double) cache.budget.bytes());
+    set("maxBytes", (double) cache.maxBytes);
+
+    args.GetReturnValue().Set(stats);
+}
+
 /* uWS.WebApp(path, [options]) */
 void uWS_WebApp_constructor(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
@@ -537,68 +1085,16 @@ void uWS_WebApp_constructor(const FunctionCallbackInfo<Value> &args) {
 
     // Apply options if provided
     if (args.Length() > 1 && args[1]->IsObject()) {
-        configureWebApp(isolate, webApp, Local<Object>::Cast(args[1]));
+        configureWebApp(isolate, perContextData, webApp, Local<Object>::Cast(args[1]));
     }
 
     /* Wire file processor hook (optional, callback stored on PerContextData) */
     webApp->fileProcessorHttp = [perContextData, webApp](uWS::HttpResponse<false> *res, uWS::HttpRequest *req, std::string_view url, std::string_view fullPath, std::string_view mimeType, int variant, std::string_view status) -> bool {
-        if (!perContextData->fileProcessorCallback || perContextData->fileProcessorCallback->IsEmpty()) {
-            return false;
-        }
-
-        uint64_t id = perContextData->nextFileProcessId++;
-        PerContextData::PendingFileProcess pending;
-        pending.ssl = false;
-        pending.res = res;
-        pending.webApp = webApp;
-        pending.url.assign(url.data(), url.size());
-        pending.fullPath.assign(fullPath.data(), fullPath.size());
-        pending.mimeType.assign(mimeType.data(), mimeType.size());
-        pending.status.assign(status.data(), status.size());
-        pending.variant = variant;
-
-        perContextData->pendingFileProcesses.emplace(id, std::move(pending));
-
-        res->onAborted([perContextData, id]() {
-            perContextData->pendingFileProcesses.erase(id);
-        });
-
-        Isolate *isolate = perContextData->isolate;
-        HandleScope hs(isolate);
-        Local<Function> cb = Local<Function>::New(isolate, *perContextData->fileProcessorCallback);
-        Local<Value> argv[] = {Number::New(isolate, (double) id), utf8(isolate, url), utf8(isolate, fullPath), utf8(isolate, mimeType)};
-        CallJS(isolate, cb, 4, argv);
-        return true;
+        return startFileProcess<false>(perContextData, webApp, res, req, url, fullPath, mimeType, variant, status);
     };
 
     webApp->fileProcessorHttps = [perContextData, webApp](uWS::HttpResponse<true> *res, uWS::HttpRequest *req, std::string_view url, std::string_view fullPath, std::string_view mimeType, int variant, std::string_view status) -> bool {
-        if (!perContextData->fileProcessorCallback || perContextData->fileProcessorCallback->IsEmpty()) {
-            return false;
-        }
-
-        uint64_t id = perContextData->nextFileProcessId++;
-        PerContextData::PendingFileProcess pending;
-        pending.ssl = true;
-        pending.res = res;
-        pending.webApp = webApp;
-        pending.url.assign(url.data(), url.size());
-        pending.fullPath.assign(fullPath.data(), fullPath.size());
-        pending.mimeType.assign(mimeType.data(), mimeType.size());
-        pending.status.assign(status.data(), status.size());
-        pending.variant = variant;
-
-        perContextData->pendingFileProcesses.emplace(id, std::move(pending));
-
-        res->onAborted([perContextData, id]() {
-            perContextData->pendingFileProcesses.erase(id);
-        });
-
-        Isolate *isolate = perContextData->isolate;
-        HandleScope hs(isolate);
-        Local<Function> cb = Local<Function>::New(isolate, *perContextData->fileProcessorCallback);
-        Local<Value> argv[] = {Number::New(isolate, (double) id), utf8(isolate, url), utf8(isolate, fullPath), utf8(isolate, mimeType)};
-        CallJS(isolate, cb, 4, argv);
-        return true;
+        return startFileProcess<true>(perContextData, webApp, res, req, url, fullPath, mimeType, variant, status);
     };
 
     /* Keep alive and allow lookup by raw pointer */
@@ -697,6 +1193,10 @@ void uWS_WebApp_constructor(const FunctionCallbackInfo<Value> &args) {
             args.GetReturnValue().Set(args.This());
         }, args.Data()));
 
+    webAppTemplate->PrototypeTemplate()->Set(
+        String::NewFromUtf8(isolate, "cacheStats", NewStringType::kNormal).ToLocalChecked(),
+        FunctionTemplate::New(isolate, uWS_WebApp_cacheStats, args.Data()));
+
     Local<Object> localWebApp = webAppTemplate->GetFunction(isolate->GetCurrentContext())
                                    .ToLocalChecked()
                                    ->NewInstance(isolate->GetCurrentContext())
@@ -845,7 +1345,7 @@ void uWS_App_constructor(const FunctionCallbackInfo<Value> &args) {
     args.GetReturnValue().Set(localApp);
 }
 
-std::pair<uWS::SocketContextOptions, bool> readOptionsObject(const FunctionCallbackInfo<Value> &args, int index) {
+std::pair<uWS::SocketContextOptions, bool> readOptionsObject(const FunctionCallbackInfo<Value> &args, int index, bool *ktls = nullptr) {
     Isolate *isolate = args.GetIsolate();
 
     uWS::SocketContextOptions options = {};
@@ -916,11 +1416,76 @@ std::pair<uWS::SocketContextOptions, bool> readOptionsObject(const FunctionCallb
             sslCiphers = sslCiphersValue.getString();
             options.ssl_ciphers = sslCiphers.c_str();
         }
+
+        /* ktls: streamFile hands TLS connections to kernel TLS to send files with sendfile, see KernelTLS */
+        if (ktls) {
+            *ktls = optionsObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "ktls", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked()->BooleanValue(isolate);
+        }
     }
 
     return {options, true};
 }
 
+/* Frames received by one ws() route during a loop iteration, delivered to messageBatch in a single call
+ * as (sockets, offsets, data, isBinary). Message i is data[offsets[i], offsets[i + 1]) */
+struct MessageBatch {
+    Isolate *isolate;
+    Global<Function> callback;
+
+    std::vector<char> data;
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> binary;
+    /* Sockets are flushed before they close, so their user data is valid until then */
+    std::vector<PerSocketData *> sockets;
+
+    /* The route's handlers own the batch, it goes away with them */
+    ~MessageBatch() {
+        uWS::Loop::get()->removePostHandler(this);
+    }
+
+    void push(PerSocketData *perSocketData, std::string_view message, bool isBinary) {
+        offsets.push_back((uint32_t) data.size());
+        data.insert(data.end(), message.begin(), message.end());
+        binary.push_back(isBinary);
+        sockets.push_back(perSocketData);
+    }
+
+    void flush() {
+        if (sockets.empty()) {
+            return;
+        }
+
+        HandleScope hs(isolate);
+        size_t length = sockets.size();
+        offsets.push_back((uint32_t) data.size());
+
+        std::vector<Local<Value>> socketObjects(length);
+        for (size_t i = 0; i < length; i++) {
+            socketObjects[i] = Local<Object>::New(isolate, sockets[i]->socketPf);
+        }
+
+        Local<ArrayBuffer> offsetsArrayBuffer = ArrayBuffer_NewCopy(isolate, offsets.data(), offsets.size() * sizeof(uint32_t));
+        Local<ArrayBuffer> binaryArrayBuffer = ArrayBuffer_NewCopy(isolate, binary.data(), binary.size());
+        Local<ArrayBuffer> dataArrayBuffer = ArrayBuffer_New(isolate, data.data(), data.size());
+
+        Local<Value> argv[4] = {Array::New(isolate, socketObjects.data(), length),
+                                Uint32Array::New(offsetsArrayBuffer, 0, offsets.size()),
+                                dataArrayBuffer,
+                                Uint8Array::New(binaryArrayBuffer, 0, binary.size())};
+
+        /* Clear first, the callback may close sockets which flushes again */
+        offsets.clear();
+        binary.clear();
+        sockets.clear();
+
+        CallJS(isolate, Local<Function>::New(isolate, callback), 4, argv);
+
+        /* data keeps its capacity for the next iteration */
+        dataArrayBuffer->Detach();
+        data.clear();
+    }
+};
+
 /* protocol.ws('/pattern', behavior) */
 template <typename PROTO>
 void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
@@ -953,6 +1518,12 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
     Global<Function> pongPf;
     Global<Function> subscriptionPf;
 
+    /* Points to the receive arena when reuseBuffers is set */
+    ReceiveArena *receiveArena = nullptr;
+
+    /* Replaces the message handler when messageBatch is set */
+    std::shared_ptr<MessageBatch> messageBatch;
+
     /* Get the behavior object */
     if (args.Length() == 2) {
         Local<Object> behaviorObject = Local<Object>::Cast(args[1]);
@@ -999,6 +1570,12 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
             behavior.maxBackpressure = maybeMaxBackpressure.ToLocalChecked()->Int32Value(isolate->GetCurrentContext()).ToChecked();
         }
 
+        /* reuseBuffers or default (message, dropped, ping and pong get Uint8Array views into a shared arena) */
+        MaybeLocal<Value> maybeReuseBuffers = behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "reuseBuffers", NewStringType::kNormal).ToLocalChecked());
+        if (!maybeReuseBuffers.IsEmpty() && maybeReuseBuffers.ToLocalChecked()->BooleanValue(isolate)) {
+            receiveArena = &perContextData->receiveArena;
+        }
+
         /* Upgrade */
         upgradePf.Reset(args.GetIsolate(), Local<Function>::Cast(behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "upgrade", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked()));
         /* Open */
@@ -1015,6 +1592,13 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
         pingPf.Reset(args.GetIsolate(), Local<Function>::Cast(behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "ping", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked()));
         /* Pong */
         pongPf.Reset(args.GetIsolate(), Local<Function>::Cast(behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "pong", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked()));
+        /* Message batch */
+        MaybeLocal<Value> maybeMessageBatch = behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "messageBatch", NewStringType::kNormal).ToLocalChecked());
+        if (!maybeMessageBatch.IsEmpty() && maybeMessageBatch.ToLocalChecked()->IsFunction()) {
+            messageBatch = std::make_shared<MessageBatch>();
+            messageBatch->isolate = isolate;
+            messageBatch->callback.Reset(isolate, Local<Function>::Cast(maybeMessageBatch.ToLocalChecked()));
+        }
     	/* Subscription */
         subscriptionPf.Reset(args.GetIsolate(), Local<Function>::Cast(behaviorObject->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "subscription", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked()));
 
@@ -1034,6 +1618,7 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
 
             Local<Object> reqObject = perContextData->reqTemplate[0].Get(isolate)->Clone();
             reqObject->SetAlignedPointerInInternalField(0, req);
+            reqObject->SetAlignedPointerInInternalField(1, SSL ? (void *) &kSecureRequestTag : nullptr);
 
             Local<Value> argv[3] = {resObject, reqObject, External::New(isolate, (void *) context)};
             CallJS(isolate, upgradeLf, 3, argv);
@@ -1044,7 +1629,7 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
     }
 
     /* Open handler is NOT optional for the wrapper */
-    behavior.open = [openPf = std::move(openPf), perContextData](auto *ws) {
+    behavior.open = [openPf = std::move(openPf), perContextData, closeOnBackpressureLimit = behavior.closeOnBackpressureLimit](auto *ws) {
         Isolate *isolate = perContextData->isolate;
         HandleScope hs(isolate);
 
@@ -1075,6 +1660,7 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
 
         /* Attach a new V8 object with pointer to us, to it */
         perSocketData->socketPf.Reset(isolate, wsObject);
+        perSocketData->closeOnBackpressureLimit = closeOnBackpressureLimit;
 
         Local<Function> openLf = Local<Function>::New(isolate, openPf);
         if (!openLf->IsUndefined()) {
@@ -1083,39 +1669,48 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
         }
     };
 
-    /* Message handler is always optional */
-    if (messagePf != Undefined(isolate)) {
-        behavior.message = [messagePf = std::move(messagePf), isolate](auto *ws, std::string_view message, uWS::OpCode opCode) {
+    /* Message handler is always optional, messageBatch takes its place */
+    if (messageBatch) {
+        /* The whole batch goes to JS at the end of the loop iteration, ticks and microtasks it queues run right after it (see CallJS) */
+        uWS::Loop::get()->addPostHandler(messageBatch.get(), [batch = messageBatch.get()](uWS::Loop *) {
+            batch->flush();
+        });
+
+        behavior.message = [messageBatch](auto *ws, std::string_view message, uWS::OpCode opCode) {
+            messageBatch->push((PerSocketData *) ws->getUserData(), message, opCode == uWS::OpCode::BINARY);
+        };
+    } else if (messagePf != Undefined(isolate)) {
+        behavior.message = [messagePf = std::move(messagePf), isolate, receiveArena](auto *ws, std::string_view message, uWS::OpCode opCode) {
             HandleScope hs(isolate);
 
-            Local<ArrayBuffer> messageArrayBuffer = ArrayBuffer_New(isolate, (void *) message.data(), message.length());
+            ReceivedData received(isolate, receiveArena, message);
 
             PerSocketData *perSocketData = (PerSocketData *) ws->getUserData();
             Local<Value> argv[3] = {Local<Object>::New(isolate, perSocketData->socketPf),
-                                    messageArrayBuffer,
+                                    received.value,
                                     Boolean::New(isolate, opCode == uWS::OpCode::BINARY)};
 
             CallJS(isolate, Local<Function>::New(isolate, messagePf), 3, argv);
 
-            messageArrayBuffer->Detach();
+            received.detach();
         };
     }
 
     /* Dropped handler is always optional */
     if (droppedPf != Undefined(isolate)) {
-        behavior.dropped = [droppedPf = std::move(droppedPf), isolate](auto *ws, std::string_view message, uWS::OpCode opCode) {
+        behavior.dropped = [droppedPf = std::move(droppedPf), isolate, receiveArena](auto *ws, std::string_view message, uWS::OpCode opCode) {
             HandleScope hs(isolate);
 
-            Local<ArrayBuffer> messageArrayBuffer = ArrayBuffer_New(isolate, (void *) message.data(), message.length());
+            ReceivedData received(isolate, receiveArena, message);
 
             PerSocketData *perSocketData = (PerSocketData *) ws->getUserData();
             Local<Value> argv[3] = {Local<Object>::New(isolate, perSocketData->socketPf),
-                                    messageArrayBuffer,
+                                    received.value,
                                     Boolean::New(isolate, opCode == uWS::OpCode::BINARY)};
 
             CallJS(isolate, Local<Function>::New(isolate, droppedPf), 3, argv);
 
-            messageArrayBuffer->Detach();
+            received.detach();
         };
     }
 
@@ -1144,30 +1739,43 @@ void uWS_Proto_ws(const FunctionCallbackInfo<Value> &args) {
 
     /* Ping handler is always optional */
     if (pingPf != Undefined(isolate)) {
-        behavior.ping = [pingPf = std::move(pingPf), isolate](auto *ws, std::string_view message) {
+        behavior.ping = [pingPf = std::move(pingPf), isolate, receiveArena](auto *ws, std::string_view message) {
             HandleScope hs(isolate);
 
+            ReceivedData received(isolate, receiveArena, message);
+
             PerSocketData *perSocketData = (PerSocketData *) ws->getUserData();
-            Local<Value> argv[2] = {Local<Object>::New(isolate, perSocketData->socketPf), ArrayBuffer_New(isolate, (void *) message.data(), message.length())};
+            Local<Value> argv[2] = {Local<Object>::New(isolate, perSocketData->socketPf), received.value};
             CallJS(isolate, Local<Function>::New(isolate, pingPf), 2, argv);
+
+            received.detach();
         };
     }
 
     /* Pong handler is always optional */
     if (pongPf != Undefined(isolate)) {
-        behavior.pong = [pongPf = std::move(pongPf), isolate](auto *ws, std::string_view message) {
+        behavior.pong = [pongPf = std::move(pongPf), isolate, receiveArena](auto *ws, std::string_view message) {
             HandleScope hs(isolate);
 
+            ReceivedData received(isolate, receiveArena, message);
+
             PerSocketData *perSocketData = (PerSocketData *) ws->getUserData();
-            Local<Value> argv[2] = {Local<Object>::New(isolate, perSocketData->socketPf), ArrayBuffer_New(isolate, (void *) message.data(), message.length())};
+            Local<Value> argv[2] = {Local<Object>::New(isolate, perSocketData->socketPf), received.value};
             CallJS(isolate, Local<Function>::New(isolate, pongPf), 2, argv);
+
+            received.detach();
         };
     }
 
     /* Close handler is NOT optional for the wrapper */
-    behavior.close = [closePf = std::move(closePf), isolate](auto *ws, int code, std::string_view message) {
+    behavior.close = [closePf = std::move(closePf), isolate, messageBatch](auto *ws, int code, std::string_view message) {
         HandleScope hs(isolate);
 
+        /* Pending batched messages are delivered before the close event (and while the socket is still valid) */
+        if (messageBatch) {
+            messageBatch->flush();
+        }
+
         Local<ArrayBuffer> messageArrayBuffer = ArrayBuffer_New(isolate, (void *) message.data(), message.length());
         PerSocketData *perSocketData = (PerSocketData *) ws->getUserData();
         Local<Object> wsObject = Local<Object>::New(isolate, perSocketData->socketPf);
@@ -1201,6 +1809,15 @@ void uWS_Proto_close(const FunctionCallbackInfo<Value> &args) {
     args.GetReturnValue().Set(args.This());
 }
 
+/* Connections accepted by a listen socket share its socket context, streamFile finds ktls protocols by it */
+template <typename PROTO, typename TOKEN>
+static void markKtlsListenSocket(const FunctionCallbackInfo<Value> &args, PROTO *proto, TOKEN *token) {
+    PerContextData *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+    if (token && perContextData->ktlsProtocols.contains(proto)) {
+        perContextData->ktlsContexts.insert(us_socket_context(1, (us_socket_t *) token));
+    }
+}
+
 /* protocol.listen(cb, path) — Unix domain socket */
 template <typename PROTO>
 void uWS_Proto_listen_unix(const FunctionCallbackInfo<Value> &args) {
@@ -1211,7 +1828,8 @@ void uWS_Proto_listen_unix(const FunctionCallbackInfo<Value> &args) {
         return;
     }
 
-    auto cb = [&args, isolate](auto *token) {
+    auto cb = [&args, isolate, proto](auto *token) {
+        markKtlsListenSocket(args, proto, token);
         Local<Value> argv[] = {token ? Local<Value>::Cast(External::New(isolate, token)) : Local<Value>::Cast(Boolean::New(isolate, false))};
         Local<Function>::Cast(args[0])->Call(isolate->GetCurrentContext(), isolate->GetCurrentContext()->Global(), 1, argv).IsEmpty();
     };
@@ -1239,7 +1857,8 @@ void uWS_Proto_listen(const FunctionCallbackInfo<Value> &args) {
     }
 
     /* Callback is last */
-    auto cb = [&args, isolate](auto *token) {
+    auto cb = [&args, isolate, proto](auto *token) {
+        markKtlsListenSocket(args, proto, token);
         Local<Value> argv[] = {token ? Local<Value>::Cast(External::New(isolate, token)) : Local<Value>::Cast(Boolean::New(isolate, false))};
         Local<Function>::Cast(args[args.Length() - 1])->Call(isolate->GetCurrentContext(), isolate->GetCurrentContext()->Global(), 1, argv).IsEmpty();
     };
@@ -1455,7 +2074,8 @@ template <typename PROTO>
 void uWS_Proto_constructor(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
 
-    auto [options, valid] = readOptionsObject(args, 0);
+    bool ktls = false;
+    auto [options, valid] = readOptionsObject(args, 0, &ktls);
     if (!valid) {
         return;
     }
@@ -1506,6 +2126,9 @@ void uWS_Proto_constructor(const FunctionCallbackInfo<Value> &args) {
     PerContextData *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
     if constexpr (isSSL) {
         perContextData->sslProtocols.emplace_back(proto);
+        if (ktls) {
+            perContextData->ktlsProtocols.insert(proto);
+        }
     } else {
         perContextData->protocols.emplace_back(proto);
     }
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <uv.h>
+
+#include "akeno/App.h"
+
+/* File access that never blocks the loop. These are libuv fs requests, which libuv runs on io_uring where the kernel
+ * allows it (libuv 1.45+, see UV_USE_IO_URING) and on its thread pool otherwise. Either way the completion comes back
+ * on the loop uSockets runs on, so callbacks may use responses directly */
+struct AsyncFile {
+    struct Request {
+        uv_fs_t req;
+        uv_loop_t *loop;
+        int fd = -1;
+        uv_stat_t stat = {};
+
+        /* readAll */
+        std::string data;
+        size_t length = 0;
+
+        uWS::MoveOnlyFunction<void(int, const uv_stat_t *)> opened;
+        uWS::MoveOnlyFunction<void(const uv_stat_t *)> statted;
+        uWS::MoveOnlyFunction<void(bool, std::string &&)> read;
+        uWS::MoveOnlyFunction<void(ssize_t)> readSome;
+    };
+
+    /* Opens and stats path, done(fd, stat) gets fd < 0 on failure. The fd is the caller's to close */
+    static void open(uv_loop_t *loop, const std::string &path, uWS::MoveOnlyFunction<void(int, const uv_stat_t *)> &&done) {
+        auto *request = new Request;
+        request->loop = loop;
+        request->opened = std::move(done);
+        request->req.data = request;
+
+        int error = uv_fs_open(loop, &request->req, path.c_str(), O_RDONLY | O_CLOEXEC, 0, [](uv_fs_t *req) {
+            Request *request = (Request *) req->data;
+            int fd = (int) req->result;
+            uv_fs_req_cleanup(req);
+
+            if (fd < 0) {
+                request->opened(-1, nullptr);
+                delete request;
+                return;
+            }
+
+            request->fd = fd;
+            int error = uv_fs_fstat(request->loop, req, fd, [](uv_fs_t *req) {
+                Request *request = (Request *) req->data;
+                bool ok = req->result == 0;
+                request->stat = req->statbuf;
+                uv_fs_req_cleanup(req);
+
+                if (!ok) {
+                    ::close(request->fd);
+                    request->opened(-1, nullptr);
+                } else {
+                    request->opened(request->fd, &request->stat);
+                }
+                delete request;
+            });
+            if (error) {
+                ::close(fd);
+                request->opened(-1, nullptr);
+                delete request;
+            }
+        });
+
+        if (error) {
+            request->opened(-1, nullptr);
+            delete request;
+        }
+    }
+
+    /* Stats path, done(stat) gets nullptr if it doesn't exist or can't be stat'ed */
+    static void stat(uv_loop_t *loop, const std::string &path, uWS::MoveOnlyFunction<void(const uv_stat_t *)> &&done) {
+        auto *request = new Request;
+        request->statted = std::move(done);
+        request->req.data = request;
+
+        int error = uv_fs_stat(loop, &request->req, path.c_str(), [](uv_fs_t *req) {
+            Request *request = (Request *) req->data;
+            bool ok = req->result == 0;
+            request->stat = req->statbuf;
+            uv_fs_req_cleanup(req);
+            request->statted(ok ? &request->stat : nullptr);
+            delete request;
+        });
+
+        if (error) {
+            request->statted(nullptr);
+            delete request;
+        }
+    }
+
+    /* Reads up to length bytes at offset into buffer, which must stay valid until done(bytes read, or < 0) */
+    static void read(uv_loop_t *loop, int fd, char *buffer, size_t length, int64_t offset, uWS::MoveOnlyFunction<void(ssize_t)> &&done) {
+        auto *request = new Request;
+        request->readSome = std::move(done);
+        request->req.data = request;
+
+        uv_buf_t buf = uv_buf_init(buffer, (unsigned int) length);
+        int error = uv_fs_read(loop, &request->req, fd, &buf, 1, offset, [](uv_fs_t *req) {
+            Request *request = (Request *) req->data;
+            ssize_t result = req->result;
+            uv_fs_req_cleanup(req);
+            request->readSome(result);
+            delete request;
+        });
+
+        if (error) {
+            request->readSome(error);
+            delete request;
+        }
+    }
+
+    /* Reads a whole file, done(false, {}) on failure */
+    static void readAll(uv_loop_t *loop, const std::string &path, uWS::MoveOnlyFunction<void(bool, std::string &&)> &&done) {
+        open(loop, path, [loop, done = std::move(done)](int fd, const uv_stat_t *stat) mutable {
+            if (fd < 0 || !S_ISREG(stat->st_mode)) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                done(false, {});
+                return;
+            }
+
+            auto *request = new Request;
+            request->loop = loop;
+            request->fd = fd;
+            request->read = std::move(done);
+            request->data.resize((size_t) stat->st_size);
+            readNext(request);
+        });
+    }
+
+    static void readNext(Request *request) {
+        /* Done when full, a file that shrank in the meantime ends early */
+        auto finish = [request](bool ok) {
+            ::close(request->fd);
+            request->data.resize(request->length);
+            request->read(ok, ok ? std::move(request->data) : std::string());
+            delete request;
+        };
+
+        if (request->length == request->data.length()) {
+            finish(true);
+            return;
+        }
+
+        read(request->loop, request->fd, request->data.data() + request->length, request->data.length() - request->length, (int64_t) request->length, [request, finish](ssize_t n) mutable {
+            if (n < 0) {
+                finish(false);
+                return;
+            }
+            if (n == 0) {
+                finish(true);
+                return;
+            }
+            request->length += (size_t) n;
+            readNext(request);
+        });
+    }
+};
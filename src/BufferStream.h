@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+#include "akeno/App.h"
+
+/* Writes the whole body of a response from memory, in chunks with tryEnd and resuming on onWritable, so a large one
+ * never piles up in the socket's buffer. Owns the data until the response is done or aborted, then deletes itself */
+template <bool SSL>
+struct BufferStream {
+    static constexpr size_t chunkSize = 64 * 1024;
+
+    uWS::HttpResponse<SSL> *res;
+    std::string data;
+
+    BufferStream(uWS::HttpResponse<SSL> *res, std::string &&data) : res(res), data(std::move(data)) {}
+
+    /* aborted (the user's abort handler, may be empty) runs if the client goes away before the end */
+    static void start(uWS::HttpResponse<SSL> *res, std::string &&data, uWS::MoveOnlyFunction<void()> &&aborted = {}) {
+        if (data.length() <= chunkSize) {
+            res->end(data);
+            return;
+        }
+
+        auto *stream = new BufferStream(res, std::move(data));
+
+        res->onAborted([stream, aborted = std::move(aborted)]() mutable {
+            delete stream;
+            if (aborted) {
+                aborted();
+            }
+        });
+        res->onWritable([stream](uint64_t) {
+            return stream->pump();
+        });
+
+        stream->pump();
+    }
+
+    /* Writes until backpressure or the end, returns whether the last write went through */
+    bool pump() {
+        while (true) {
+            auto [ok, done] = res->tryEnd(std::string_view(data).substr((size_t) res->getWriteOffset(), chunkSize), data.length());
+            if (done) {
+                delete this;
+                return true;
+            }
+            if (!ok) {
+                return false;
+            }
+        }
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstdio>
+
+#include "akeno/App.h"
+
+/* Range requests (RFC 9110 14) for content of a known size, single ranges as 206 and several as multipart/byteranges */
+struct ByteRanges {
+    struct Range {
+        uint64_t start;
+        uint64_t length;
+    };
+
+    enum Result {
+        /* No usable Range header, serve the whole thing */
+        FULL,
+        PARTIAL,
+        UNSATISFIABLE
+    };
+
+    /* More ranges than this are served as a whole, they are only good for making us work */
+    static constexpr size_t maxRanges = 16;
+
+    Result result = FULL;
+    uint64_t size = 0;
+    std::vector<Range> ranges;
+    std::string contentType;
+    std::string boundary;
+
+    ByteRanges(std::string_view header, uint64_t size, std::string_view contentType = {}) : size(size), contentType(contentType) {
+        result = parse(header, size, ranges);
+        if (ranges.size() > 1) {
+            static thread_local std::mt19937_64 random{std::random_device{}()};
+            char buffer[24];
+            int length = snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long) random());
+            boundary.assign(buffer, (size_t) length);
+        }
+    }
+
+    static Result parse(std::string_view header, uint64_t size, std::vector<Range> &ranges) {
+        ranges.clear();
+
+        constexpr std::string_view unit = "bytes=";
+        if (header.length() <= unit.length() || header.substr(0, unit.length()) != unit) {
+            return FULL;
+        }
+        header.remove_prefix(unit.length());
+
+        auto number = [](std::string_view digits, uint64_t &out) {
+            if (digits.empty() || digits.length() > 19) {
+                return false;
+            }
+            out = 0;
+            for (char c : digits) {
+                if (c < '0' || c > '9') {
+                    return false;
+                }
+                out = out * 10 + (uint64_t) (c - '0');
+            }
+            return true;
+        };
+
+        size_t specs = 0;
+        while (header.length()) {
+            size_t comma = header.find(',');
+            std::string_view spec = header.substr(0, comma);
+            header = comma == std::string_view::npos ? std::string_view() : header.substr(comma + 1);
+
+            while (spec.length() && (spec.front() == ' ' || spec.front() == '\t')) spec.remove_prefix(1);
+            while (spec.length() && (spec.back() == ' ' || spec.back() == '\t')) spec.remove_suffix(1);
+            if (spec.empty()) {
+                continue;
+            }
+
+            if (++specs > maxRanges) {
+                ranges.clear();
+                return FULL;
+            }
+
+            size_t dash = spec.find('-');
+            if (dash == std::string_view::npos) {
+                ranges.clear();
+                return FULL;
+            }
+
+            uint64_t first, last;
+            if (dash == 0) {
+                /* Suffix range, the last n bytes */
+                if (!number(spec.substr(1), last)) {
+                    ranges.clear();
+                    return FULL;
+                }
+                if (last && size) {
+                    uint64_t length = std::min(last, size);
+                    ranges.push_back({size - length, length});
+                }
+                continue;
+            }
+
+            if (!number(spec.substr(0, dash), first)) {
+                ranges.clear();
+                return FULL;
+            }
+            if (dash + 1 == spec.length()) {
+                last = size ? size - 1 : 0;
+            } else if (!number(spec.substr(dash + 1), last) || last < first) {
+                ranges.clear();
+                return FULL;
+            }
+
+            if (first < size) {
+                last = std::min(last, size - 1);
+                ranges.push_back({first, last - first + 1});
+            }
+        }
+
+        if (!specs) {
+            return FULL;
+        }
+        if (ranges.empty()) {
+            return UNSATISFIABLE;
+        }
+
+        /* Overlapping or adjacent ranges are coalesced, as RFC 9110 14.3 allows */
+        if (ranges.size() > 1) {
+            std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b) {
+                return a.start < b.start;
+            });
+
+            size_t out = 0;
+            for (size_t i = 1; i < ranges.size(); i++) {
+                Range &previous = ranges[out];
+                if (ranges[i].start <= previous.start + previous.length) {
+                    previous.length = std::max(previous.start + previous.length, ranges[i].start + ranges[i].length) - previous.start;
+                } else {
+                    ranges[++out] = ranges[i];
+                }
+            }
+            ranges.resize(out + 1);
+        }
+        return PARTIAL;
+    }
+
+    std::string contentRange(const Range &range) const {
+        char buffer[64];
+        int length = snprintf(buffer, sizeof(buffer), "bytes %llu-%llu/%llu", (unsigned long long) range.start,
+            (unsigned long long) (range.start + range.length - 1), (unsigned long long) size);
+        return std::string(buffer, (size_t) length);
+    }
+
+    /* What goes before the data of a range in multipart/byteranges */
+    std::string partHeader(const Range &range) const {
+        std::string header = "\r\n--" + boundary + "\r\n";
+        if (contentType.length()) {
+            header += "Content-Type: " + contentType + "\r\n";
+        }
+        header += "Content-Range: " + contentRange(range) + "\r\n\r\n";
+        return header;
+    }
+
+    std::string trailer() const {
+        return "\r\n--" + boundary + "--\r\n";
+    }
+
+    uint64_t contentLength() const {
+        uint64_t length = 0;
+        for (const Range &range : ranges) {
+            length += range.length;
+            if (ranges.size() > 1) {
+                length += partHeader(range).length();
+            }
+        }
+        return ranges.size() > 1 ? length + trailer().length() : length;
+    }
+
+    /* Status and headers of a PARTIAL response, the body follows with tryEnd or end */
+    template <class Response>
+    void writeHead(Response *res) const {
+        res->writeStatus("206 Partial Content");
+        if (ranges.size() > 1) {
+            res->writeHeader("Content-Type", "multipart/byteranges; boundary=" + boundary);
+        } else {
+            if (contentType.length()) {
+                res->writeHeader("Content-Type", contentType);
+            }
+            res->writeHeader("Content-Range", contentRange(ranges[0]));
+        }
+    }
+
+    template <class Response>
+    void endUnsatisfiable(Response *res) const {
+        char buffer[40];
+        int length = snprintf(buffer, sizeof(buffer), "bytes */%llu", (unsigned long long) size);
+        res->writeStatus("416 Range Not Satisfiable")->writeHeader("Content-Range", std::string_view(buffer, (size_t) length))->end();
+    }
+
+    /* Answers a PARTIAL request for content that is in memory */
+    template <class Response>
+    void endFromBuffer(Response *res, std::string_view data) const {
+        writeHead(res);
+        if (ranges.size() == 1) {
+            res->end(data.substr(ranges[0].start, ranges[0].length));
+            return;
+        }
+
+        std::string body;
+        body.reserve(contentLength());
+        for (const Range &range : ranges) {
+            body += partHeader(range);
+            body.append(data.substr(range.start, range.length));
+        }
+        body += trailer();
+        res->end(body);
+    }
+};
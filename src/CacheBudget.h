@@ -0,0 +1,212 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <cstdint>
+
+#include "akeno/App.h"
+#include "akeno/external/ankerl/unordered_dense.h"
+#include "Precompressor.h"
+
+/* Byte budget with S3-FIFO eviction (Yang et al., SOSP '23). New entries go to a small FIFO and only move to the main
+ * FIFO if they were used again before falling out, so one-off scans never push out the working set. Keys evicted from
+ * the small FIFO are remembered in a ghost FIFO and go straight to main if they come back */
+struct CacheBudget {
+    struct Entry {
+        std::string key;
+        size_t bytes;
+        uint8_t frequency;
+        bool main;
+    };
+
+    /* The last limit given to shrinkTo, the small FIFO gets 10% of it */
+    size_t maxBytes = 0;
+
+    size_t smallBytes = 0, mainBytes = 0;
+    uint64_t evictions = 0;
+
+    std::list<Entry> small, main;
+    std::list<std::string> ghost;
+
+    ankerl::unordered_dense::map<std::string, std::list<Entry>::iterator> entries;
+    ankerl::unordered_dense::map<std::string, std::list<std::string>::iterator> ghosts;
+
+    size_t bytes() const {
+        return smallBytes + mainBytes;
+    }
+
+    /* Marks an entry as used, returns false if it is not tracked */
+    bool touch(const std::string &key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+        if (it->second->frequency < 3) {
+            it->second->frequency++;
+        }
+        return true;
+    }
+
+    /* Adds or resizes an entry, see shrinkTo for eviction */
+    void insert(const std::string &key, size_t bytes) {
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            (it->second->main ? mainBytes : smallBytes) -= it->second->bytes;
+            it->second->bytes = bytes;
+            (it->second->main ? mainBytes : smallBytes) += bytes;
+            touch(key);
+        } else {
+            auto ghostIt = ghosts.find(key);
+            bool toMain = ghostIt != ghosts.end();
+            if (toMain) {
+                ghost.erase(ghostIt->second);
+                ghosts.erase(ghostIt);
+            }
+
+            std::list<Entry> &queue = toMain ? main : small;
+            queue.push_front({key, bytes, 0, toMain});
+            (toMain ? mainBytes : smallBytes) += bytes;
+            entries[key] = queue.begin();
+        }
+    }
+
+    /* Forgets an entry without counting an eviction */
+    void erase(const std::string &key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return;
+        }
+        (it->second->main ? mainBytes : smallBytes) -= it->second->bytes;
+        (it->second->main ? main : small).erase(it->second);
+        entries.erase(it);
+    }
+
+    /* Evicts entries until at most limit bytes remain, calling onEvict with each key */
+    template <class F>
+    void shrinkTo(size_t limit, F &&onEvict) {
+        maxBytes = limit;
+        while (bytes() > limit && !entries.empty()) {
+            evictOne(onEvict);
+        }
+    }
+
+    template <class F>
+    void evictOne(F &onEvict) {
+        if (!small.empty() && (main.empty() || smallBytes * 10 >= maxBytes)) {
+            Entry entry = std::move(small.back());
+            small.pop_back();
+            smallBytes -= entry.bytes;
+
+            if (entry.frequency > 1) {
+                entry.frequency = 0;
+                entry.main = true;
+                mainBytes += entry.bytes;
+                main.push_front(std::move(entry));
+                entries[main.front().key] = main.begin();
+                return;
+            }
+
+            ghost.push_front(entry.key);
+            ghosts[entry.key] = ghost.begin();
+            /* Ghosts remember about as many keys as main holds */
+            while (ghost.size() > main.size() + 1) {
+                ghosts.erase(ghost.back());
+                ghost.pop_back();
+            }
+
+            entries.erase(entry.key);
+            evictions++;
+            onEvict(entry.key);
+            return;
+        }
+
+        /* Main is a CLOCK-like FIFO, used entries get another round */
+        while (true) {
+            Entry entry = std::move(main.back());
+            main.pop_back();
+
+            if (entry.frequency > 0) {
+                entry.frequency--;
+                main.push_front(std::move(entry));
+                entries[main.front().key] = main.begin();
+                continue;
+            }
+
+            mainBytes -= entry.bytes;
+            entries.erase(entry.key);
+            evictions++;
+            onEvict(entry.key);
+            return;
+        }
+    }
+};
+
+/* What the addon keeps next to the FileCache of a WebApp: validators and precompressed variants of processed files.
+ * FileCache owns the files themselves and can't evict them from here, so only the variants are bounded. Only touched
+ * from the loop thread */
+struct WebAppCache {
+    PrecompressOptions precompress;
+
+    /* Budget for the variants (options.precompress.maxBytes), 0 means unbounded */
+    size_t maxBytes = 0;
+
+    /* A finished precompression job replaces the whole variant set of its file at once,
+     * so a request sees either identity only or every finished variant */
+    ankerl::unordered_dense::map<std::string, std::shared_ptr<const PrecompressedVariants>> variants;
+
+    /* The running compression job per file, a result with any other generation is for stale content and dropped */
+    ankerl::unordered_dense::map<std::string, uint64_t> generations;
+    uint64_t nextGeneration = 1;
+
+    /* Strong validators of processed files, lastModified only moves when the content actually changed */
+    struct Validator {
+        std::string etag;
+        int64_t lastModified = 0;
+        std::string lastModifiedHeader;
+    };
+
+    ankerl::unordered_dense::map<std::string, Validator> validators;
+
+    /* Variants by full path */
+    CacheBudget budget;
+
+    uint64_t misses = 0, coalesced = 0, updates = 0, variantHits = 0, notModified = 0;
+
+    /* Variants of a processed file, counts as a use for eviction. variantHits counts the responses actually served from them */
+    std::shared_ptr<const PrecompressedVariants> get(const std::string &fullPath) {
+        auto it = variants.find(fullPath);
+        if (it == variants.end()) {
+            return nullptr;
+        }
+        budget.touch(fullPath);
+        return it->second;
+    }
+
+    void setVariants(const std::string &fullPath, std::shared_ptr<const PrecompressedVariants> fileVariants) {
+        budget.insert(fullPath, fileVariants->gzip.length() + fileVariants->brotli.length() + fileVariants->zstd.length());
+        variants[fullPath] = std::move(fileVariants);
+        shrinkTo(maxBytes);
+    }
+
+    void eraseVariants(const std::string &fullPath) {
+        variants.erase(fullPath);
+        budget.erase(fullPath);
+    }
+
+    /* Drops everything about a file that is gone */
+    void forget(const std::string &fullPath) {
+        eraseVariants(fullPath);
+        generations.erase(fullPath);
+        validators.erase(fullPath);
+    }
+
+    /* Evicts variants until they fit into limit bytes, 0 means unbounded */
+    void shrinkTo(size_t limit) {
+        if (!limit) {
+            return;
+        }
+        budget.shrinkTo(limit, [this](const std::string &fullPath) {
+            variants.erase(fullPath);
+        });
+    }
+};
@@ -0,0 +1,270 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cctype>
+#include <algorithm>
+
+#include "akeno/App.h"
+#include "akeno/external/ankerl/unordered_dense.h"
+
+/* Per-route micro-cache for dynamic responses (app.route(pattern, handler, { cache })).
+ * Hits are answered from here without entering JS, misses go through CachedHttpResponse which records what JS writes */
+struct ResponseCache {
+    struct Entry {
+        std::string status;
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::chrono::milliseconds ttl;
+
+    /* Query parameters and request headers (lowercase) that take part in the key, besides host and path */
+    std::vector<std::string> query;
+    std::vector<std::string> vary;
+
+    /* Limits of the whole cache. Expired entries are swept every ttl and when a limit is reached, if that is not
+     * enough the quarter of entries closest to expiring goes too. Responses larger than maxBytes are not stored */
+    size_t maxEntries = 1024;
+    size_t maxBytes = 8 * 1024 * 1024;
+
+    ankerl::unordered_dense::map<std::string, Entry> entries;
+    size_t bytes = 0;
+    std::chrono::steady_clock::time_point nextSweep;
+
+    ResponseCache(std::chrono::milliseconds ttl, std::vector<std::string> query, std::vector<std::string> vary) : ttl(ttl), query(std::move(query)), vary(std::move(vary)) {
+        for (std::string &header : this->vary) {
+            for (char &c : header) {
+                c = (char) std::tolower((unsigned char) c);
+            }
+        }
+    }
+
+    /* Key parts are separated by zero bytes, which can't appear in a parsed request */
+    void makeKey(std::string &key, uWS::HttpRequest *req) const {
+        key.clear();
+        key.append(req->getHeader("host"));
+        key.push_back('\0');
+        key.append(req->getUrl());
+        for (const std::string &name : query) {
+            key.push_back('\0');
+            key.append(req->getQuery(name));
+        }
+        for (const std::string &name : vary) {
+            key.push_back('\0');
+            key.append(req->getHeader(name));
+        }
+    }
+
+    /* Requests with credentials are neither answered from nor stored in the cache, unless those headers are part of the key */
+    bool bypasses(uWS::HttpRequest *req) const {
+        auto keyed = [this](std::string_view name) {
+            return std::find(vary.begin(), vary.end(), name) != vary.end();
+        };
+        return (req->getHeader("authorization").length() && !keyed("authorization")) || (req->getHeader("cookie").length() && !keyed("cookie"));
+    }
+
+    /* Responds and returns true on a fresh hit */
+    template <bool SSL>
+    bool tryServe(uWS::HttpResponse<SSL> *res, const std::string &key) {
+        auto it = entries.find(key);
+        if (it == entries.end()) {
+            return false;
+        }
+
+        if (it->second.expires <= std::chrono::steady_clock::now()) {
+            bytes -= size(it->first, it->second);
+            entries.erase(it);
+            return false;
+        }
+
+        const Entry &entry = it->second;
+        if (entry.status.length()) {
+            res->writeStatus(entry.status);
+        }
+        for (auto &[key, value] : entry.headers) {
+            res->writeHeader(key, value);
+        }
+        res->end(entry.body);
+        return true;
+    }
+
+    static size_t size(const std::string &key, const Entry &entry) {
+        size_t total = key.length() + entry.status.length() + entry.body.length();
+        for (auto &[name, value] : entry.headers) {
+            total += name.length() + value.length();
+        }
+        return total;
+    }
+
+    void evict(std::chrono::steady_clock::time_point now, bool full) {
+        std::erase_if(entries, [&](const auto &pair) {
+            if (pair.second.expires <= now) {
+                bytes -= size(pair.first, pair.second);
+                return true;
+            }
+            return false;
+        });
+        nextSweep = now + ttl;
+
+        if (full) {
+            /* Same ttl for all, so these are the oldest ones */
+            std::vector<std::chrono::steady_clock::time_point> expires;
+            expires.reserve(entries.size());
+            for (auto &[key, entry] : entries) {
+                expires.push_back(entry.expires);
+            }
+            auto cutoff = expires.begin() + expires.size() / 4;
+            std::nth_element(expires.begin(), cutoff, expires.end());
+            std::erase_if(entries, [&](const auto &pair) {
+                if (pair.second.expires <= *cutoff) {
+                    bytes -= size(pair.first, pair.second);
+                    return true;
+                }
+                return false;
+            });
+        }
+    }
+
+    void store(std::string key, Entry &&entry) {
+        auto now = std::chrono::steady_clock::now();
+
+        size_t entrySize = size(key, entry);
+        if (entrySize > maxBytes) {
+            return;
+        }
+
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            bytes -= size(it->first, it->second);
+            entries.erase(it);
+        }
+
+        if (now >= nextSweep || entries.size() >= maxEntries || bytes + entrySize > maxBytes) {
+            evict(now, false);
+            while (entries.size() && (entries.size() >= maxEntries || bytes + entrySize > maxBytes)) {
+                evict(now, true);
+            }
+        }
+
+        entry.expires = now + ttl;
+        bytes += entrySize;
+        entries[std::move(key)] = std::move(entry);
+    }
+};
+
+/* What JS gets as res (PROTOCOL 3) on a cache miss. Forwards everything to the real response and records it,
+ * a successful response without set-cookie and without Cache-Control no-store, private or no-cache is stored when
+ * it ends. Deletes itself on end or abort */
+struct CachedHttpResponse {
+    void *res;
+    bool ssl;
+
+    std::shared_ptr<ResponseCache> cache;
+    std::string key;
+    ResponseCache::Entry entry;
+    bool cacheable = true;
+
+    uWS::MoveOnlyFunction<void()> abortedHandler;
+
+    CachedHttpResponse(void *res, bool ssl, std::shared_ptr<ResponseCache> cache, std::string key) : res(res), ssl(ssl), cache(std::move(cache)), key(std::move(key)) {}
+
+    /* name is lowercase */
+    static bool equalsLowercase(std::string_view key, std::string_view name) {
+        if (key.length() != name.length()) {
+            return false;
+        }
+        for (size_t i = 0; i < key.length(); i++) {
+            if (std::tolower((unsigned char) key[i]) != name[i]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /* Whether a Cache-Control value keeps shared caches from storing the response */
+    static bool forbidsStoring(std::string_view cacheControl) {
+        while (cacheControl.length()) {
+            size_t comma = cacheControl.find(',');
+            std::string_view directive = cacheControl.substr(0, comma);
+            cacheControl = comma == std::string_view::npos ? std::string_view() : cacheControl.substr(comma + 1);
+
+            directive = directive.substr(0, directive.find('='));
+            while (directive.length() && directive.front() == ' ') directive.remove_prefix(1);
+            while (directive.length() && directive.back() == ' ') directive.remove_suffix(1);
+            if (equalsLowercase(directive, "no-store") || equalsLowercase(directive, "private") || equalsLowercase(directive, "no-cache")) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    template <class F>
+    decltype(auto) forward(F &&f) {
+        if (ssl) {
+            return f((uWS::HttpResponse<true> *) res);
+        }
+        return f((uWS::HttpResponse<false> *) res);
+    }
+
+    CachedHttpResponse *writeStatus(std::string_view status) {
+        entry.status = status;
+        cacheable = cacheable && (status.empty() || status[0] == '2');
+        forward([&](auto *res) { res->writeStatus(status); });
+        return this;
+    }
+
+    CachedHttpResponse *writeHeader(std::string_view key, std::string_view value) {
+        if (equalsLowercase(key, "set-cookie") || (equalsLowercase(key, "cache-control") && forbidsStoring(value))) {
+            cacheable = false;
+        }
+        if (cacheable) {
+            entry.headers.emplace_back(key, value);
+        }
+        forward([&](auto *res) { res->writeHeader(key, value); });
+        return this;
+    }
+
+    CachedHttpResponse *writeHeader(std::string_view key, uint64_t value) {
+        return writeHeader(key, std::string_view(std::to_string(value)));
+    }
+
+    bool write(std::string_view data) {
+        if (cacheable) {
+            entry.body.append(data);
+        }
+        return forward([&](auto *res) { return res->write(data); });
+    }
+
+    void end(std::string_view data = {}, bool closeConnection = false) {
+        if (cacheable) {
+            entry.body.append(data);
+            cache->store(std::move(key), std::move(entry));
+        }
+        forward([&](auto *res) { res->end(data, closeConnection); });
+        delete this;
+    }
+
+    template <class F>
+    CachedHttpResponse *cork(F &&handler) {
+        forward([&](auto *res) { res->cork(std::move(handler)); });
+        return this;
+    }
+
+    /* The real abort handler is installed by the route once JS returned without ending, see aborted */
+    CachedHttpResponse *onAborted(uWS::MoveOnlyFunction<void()> &&handler) {
+        abortedHandler = std::move(handler);
+        return this;
+    }
+
+    void aborted() {
+        if (abortedHandler) {
+            abortedHandler();
+        }
+        delete this;
+    }
+};
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <bit>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define AKENO_SCAN_SSE2
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+/* Builds target the x86-64 baseline, AVX2 is picked at runtime where the CPU has it */
+#define AKENO_SCAN_AVX2
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#include <arm_neon.h>
+#define AKENO_SCAN_NEON
+#endif
+
+/* Finds the next of a few bytes known at compile time, such as the structural characters of HTML and Markdown
+ * ('<', '>', '@', quotes, '*', '`' ...), 16 to 64 bytes at a time. Short input and the tail go byte by byte.
+ * Only contains<'@'> (onText) is used so far, and a single character goes to memchr. The SSE2/AVX2/NEON paths have no
+ * caller in this tree yet, tests/ParserTests.cpp checks and measures them */
+namespace CharScan {
+
+    template <unsigned char... Chars>
+    static inline size_t scalar(const char *data, size_t length, size_t i) {
+        for (; i < length; i++) {
+            unsigned char c = (unsigned char) data[i];
+            if (((c == Chars) || ...)) {
+                return i;
+            }
+        }
+        return std::string_view::npos;
+    }
+
+#ifdef AKENO_SCAN_SSE2
+    template <unsigned char... Chars>
+    static inline size_t sse2(const char *data, size_t length, size_t i) {
+        for (; i + 16 <= length; i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i *) (data + i));
+            __m128i hits = _mm_setzero_si128();
+            ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8((char) Chars)))), ...);
+
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(hits);
+            if (mask) {
+                return i + (size_t) std::countr_zero(mask);
+            }
+        }
+        return scalar<Chars...>(data, length, i);
+    }
+#endif
+
+#ifdef AKENO_SCAN_AVX2
+    template <unsigned char... Chars>
+    __attribute__((target("avx2"))) static size_t avx2(const char *data, size_t length, size_t i) {
+        /* Two blocks per step, the hit test of both is one branch */
+        for (; i + 64 <= length; i += 64) {
+            __m256i first = _mm256_loadu_si256((const __m256i *) (data + i));
+            __m256i second = _mm256_loadu_si256((const __m256i *) (data + i + 32));
+            __m256i hitsFirst = _mm256_setzero_si256(), hitsSecond = _mm256_setzero_si256();
+            ((hitsFirst = _mm256_or_si256(hitsFirst, _mm256_cmpeq_epi8(first, _mm256_set1_epi8((char) Chars)))), ...);
+            ((hitsSecond = _mm256_or_si256(hitsSecond, _mm256_cmpeq_epi8(second, _mm256_set1_epi8((char) Chars)))), ...);
+
+            if (!_mm256_testz_si256(_mm256_or_si256(hitsFirst, hitsSecond), _mm256_or_si256(hitsFirst, hitsSecond))) {
+                uint64_t mask = (uint64_t) (uint32_t) _mm256_movemask_epi8(hitsFirst) | ((uint64_t) (uint32_t) _mm256_movemask_epi8(hitsSecond) << 32);
+                return i + (size_t) std::countr_zero(mask);
+            }
+        }
+        return sse2<Chars...>(data, length, i);
+    }
+
+    static inline bool hasAVX2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+#endif
+
+#ifdef AKENO_SCAN_NEON
+    template <unsigned char... Chars>
+    static inline size_t neon(const char *data, size_t length, size_t i) {
+        for (; i + 16 <= length; i += 16) {
+            uint8x16_t block = vld1q_u8((const uint8_t *) (data + i));
+            uint8x16_t hits = vdupq_n_u8(0);
+            ((hits = vorrq_u8(hits, vceqq_u8(block, vdupq_n_u8(Chars)))), ...);
+
+            /* NEON has no movemask, narrowing gives 4 bits per byte instead */
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)), 0);
+            if (mask) {
+                return i + (size_t) (std::countr_zero(mask) >> 2);
+            }
+        }
+        return scalar<Chars...>(data, length, i);
+    }
+#endif
+
+    /* Position of the first of Chars in data at or after from, npos if there is none */
+    template <unsigned char... Chars>
+    static inline size_t findFirstOf(std::string_view data, size_t from = 0) {
+        static_assert(sizeof...(Chars) > 0 && sizeof...(Chars) <= 8, "Scan for 1 to 8 characters");
+
+        if (from >= data.length()) {
+            return std::string_view::npos;
+        }
+
+        /* libc's memchr is vectorized already, and picks its variant at runtime too */
+        if constexpr (sizeof...(Chars) == 1) {
+            const void *hit = memchr(data.data() + from, (int) (Chars, ...), data.length() - from);
+            return hit ? (size_t) ((const char *) hit - data.data()) : std::string_view::npos;
+        }
+
+        if (data.length() - from < 16) {
+            return scalar<Chars...>(data.data(), data.length(), from);
+        }
+
+#if defined(AKENO_SCAN_AVX2)
+        if (data.length() - from >= 64 && hasAVX2()) {
+            return avx2<Chars...>(data.data(), data.length(), from);
+        }
+        return sse2<Chars...>(data.data(), data.length(), from);
+#elif defined(AKENO_SCAN_SSE2)
+        return sse2<Chars...>(data.data(), data.length(), from);
+#elif defined(AKENO_SCAN_NEON)
+        return neon<Chars...>(data.data(), data.length(), from);
+#else
+        return scalar<Chars...>(data.data(), data.length(), from);
+#endif
+    }
+
+    /* Calls found(position) for every one of Chars in data, in order, until it returns false. Dense input (markup is
+     * mostly structure) does better with this than with findFirstOf per hit, every block is compared once */
+    template <unsigned char... Chars, class Found>
+    static inline void forEach(std::string_view data, Found &&found) {
+        const char *p = data.data();
+        size_t length = data.length(), i = 0;
+
+#if defined(AKENO_SCAN_SSE2) || defined(AKENO_SCAN_NEON)
+        for (; i + 16 <= length; i += 16) {
+#if defined(AKENO_SCAN_SSE2)
+            __m128i block = _mm_loadu_si128((const __m128i *) (p + i));
+            __m128i hits = _mm_setzero_si128();
+            ((hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8((char) Chars)))), ...);
+            unsigned int mask = (unsigned int) _mm_movemask_epi8(hits);
+            constexpr int bitsPerByte = 1;
+#else
+            uint8x16_t block = vld1q_u8((const uint8_t *) (p + i));
+            uint8x16_t hits = vdupq_n_u8(0);
+            ((hits = vorrq_u8(hits, vceqq_u8(block, vdupq_n_u8(Chars)))), ...);
+            uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)) , 0) & 0x8888888888888888ull;
+            constexpr int bitsPerByte = 4;
+#endif
+            while (mask) {
+                if (!found(i + (size_t) (std::countr_zero(mask) / bitsPerByte))) {
+                    return;
+                }
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        for (; i < length; i++) {
+            unsigned char c = (unsigned char) p[i];
+            if (((c == Chars) || ...) && !found(i)) {
+                return;
+            }
+        }
+    }
+
+    template <unsigned char... Chars>
+    static inline bool contains(std::string_view data) {
+        return findFirstOf<Chars...>(data) != std::string_view::npos;
+    }
+
+    /* The characters the HTML tokenizer stops at */
+    static inline size_t findHTMLStructural(std::string_view data, size_t from = 0) {
+        return findFirstOf<'<', '>', '@', '"', '\''>(data, from);
+    }
+
+    /* The characters inline Markdown stops at */
+    static inline size_t findMarkdownStructural(std::string_view data, size_t from = 0) {
+        return findFirstOf<'*', '_', '`', '[', ']', '!', '<', '\\'>(data, from);
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+#include "akeno/DomainHandler.h"
+#include "akeno/App.h"
+
+/* Native interpreter for DeclarativeResponse programs (see uws.js), so that routes like health checks,
+ * redirects or echo endpoints never enter JS. The program is decoded once, when the route is added */
+struct DeclarativeProgram {
+    enum Opcode : uint8_t {
+        END = 0,
+        WRITE_HEADER = 1,
+        WRITE_BODY = 2,
+        WRITE_QUERY_VALUE = 3,
+        WRITE_HEADER_VALUE = 4,
+        WRITE = 5,
+        WRITE_PARAMETER_VALUE = 6
+    };
+
+    struct Instruction {
+        Opcode opcode;
+        std::string_view key;
+        std::string_view value;
+    };
+
+    /* Instructions point into source */
+    std::string source;
+    std::vector<Instruction> instructions;
+    bool readsBody = false;
+
+    /* Echo endpoints buffer the request body up to this size, larger ones get 413 */
+    static constexpr size_t kMaxBodyLength = 1024 * 1024;
+
+    /* Returns nullptr on a malformed program */
+    static std::shared_ptr<DeclarativeProgram> parse(std::string_view program) {
+        auto self = std::make_shared<DeclarativeProgram>();
+        self->source = program;
+
+        std::string_view in = self->source;
+        size_t i = 0;
+
+        /* 1-byte length prefixed string */
+        auto shortString = [&](std::string_view &out) {
+            if (i >= in.length() || i + 1 + (uint8_t) in[i] > in.length()) {
+                return false;
+            }
+            out = in.substr(i + 1, (uint8_t) in[i]);
+            i += 1 + out.length();
+            return true;
+        };
+
+        /* 2-byte little-endian length prefixed string */
+        auto longString = [&](std::string_view &out) {
+            if (i + 2 > in.length()) {
+                return false;
+            }
+            size_t length = (uint8_t) in[i] | ((uint8_t) in[i + 1] << 8);
+            if (i + 2 + length > in.length()) {
+                return false;
+            }
+            out = in.substr(i + 2, length);
+            i += 2 + length;
+            return true;
+        };
+
+        while (i < in.length()) {
+            Instruction instruction = {(Opcode) in[i++], {}, {}};
+
+            bool valid = false;
+            switch (instruction.opcode) {
+            case END:
+            case WRITE:
+                valid = longString(instruction.value);
+                break;
+            case WRITE_HEADER:
+                valid = shortString(instruction.key) && shortString(instruction.value);
+                break;
+            case WRITE_BODY:
+                self->readsBody = valid = true;
+                break;
+            case WRITE_QUERY_VALUE:
+            case WRITE_HEADER_VALUE:
+            case WRITE_PARAMETER_VALUE:
+                valid = shortString(instruction.key);
+                break;
+            }
+
+            if (!valid) {
+                return nullptr;
+            }
+
+            self->instructions.push_back(instruction);
+            if (instruction.opcode == END) {
+                return self;
+            }
+        }
+
+        /* Programs always end with END */
+        return nullptr;
+    }
+
+    /* Appends the output of instructions, stops at WRITE_BODY (returns its index) or at the end */
+    size_t render(std::string &out, size_t from, uWS::HttpRequest *req) const {
+        for (size_t i = from; i < instructions.size(); i++) {
+            const Instruction &instruction = instructions[i];
+            switch (instruction.opcode) {
+            case WRITE_QUERY_VALUE:
+                out.append(req->getQuery(instruction.key));
+                break;
+            case WRITE_HEADER_VALUE:
+                out.append(req->getHeader(instruction.key));
+                break;
+            case WRITE_PARAMETER_VALUE:
+                out.append(req->getParameter(instruction.key));
+                break;
+            case WRITE:
+            case END:
+                out.append(instruction.value);
+                break;
+            case WRITE_BODY:
+                return i;
+            case WRITE_HEADER:
+                break;
+            }
+        }
+        return instructions.size();
+    }
+
+    template <bool SSL>
+    void writeHeaders(uWS::HttpResponse<SSL> *res) const {
+        for (const Instruction &instruction : instructions) {
+            if (instruction.opcode == WRITE_HEADER) {
+                res->writeHeader(instruction.key, instruction.value);
+            }
+        }
+    }
+
+    template <bool SSL>
+    static void execute(const std::shared_ptr<DeclarativeProgram> &program, uWS::HttpResponse<SSL> *res, uWS::HttpRequest *req) {
+        if (!program->readsBody) {
+            /* The whole response is known now, send it with a content-length */
+            thread_local std::string body;
+            body.clear();
+            program->render(body, 0, req);
+
+            program->writeHeaders(res);
+            res->end(body);
+            return;
+        }
+
+        /* Everything that depends on req is resolved now, parts are joined by the request body later */
+        std::vector<std::string> parts(1);
+        size_t next = program->render(parts.back(), 0, req);
+        while (next < program->instructions.size()) {
+            parts.emplace_back();
+            next = program->render(parts.back(), next + 1, req);
+        }
+
+        res->onAborted([]() {});
+        res->onData([program, res, parts = std::move(parts), body = std::string()](std::string_view chunk, bool isLast) mutable {
+            if (body.length() + chunk.length() > kMaxBodyLength) {
+                /* Only respond once */
+                if (!parts.empty()) {
+                    parts.clear();
+                    res->writeStatus("413 Payload Too Large")->end();
+                }
+                return;
+            }
+
+            body.append(chunk);
+            if (!isLast || parts.empty()) {
+                return;
+            }
+
+            std::string out = std::move(parts[0]);
+            for (size_t i = 1; i < parts.size(); i++) {
+                out.append(body);
+                out.append(parts[i]);
+            }
+
+            program->writeHeaders(res);
+            res->end(out);
+        });
+    }
+
+    /* The DomainHandler::fromDeclarative this is meant to be; DomainHandler lives in the uWS fork */
+    static DomainHandler toDomainHandler(std::shared_ptr<DeclarativeProgram> program) {
+        return DomainHandler::onRequestBoth(
+            [program](uWS::HttpResponse<false> *res, uWS::HttpRequest *req) {
+                execute<false>(program, res, req);
+            },
+            [program](uWS::HttpResponse<true> *res, uWS::HttpRequest *req) {
+                execute<true>(program, res, req);
+            }
+        );
+    }
+};
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+
+#include <unistd.h>
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#endif
+
+#include "akeno/App.h"
+#include "ByteRanges.h"
+#include "AsyncFile.h"
+#include "KernelTLS.h"
+
+/* Streams a file, or ranges of it, as the body of a response. Owns the fd and closes it, deletes itself once done or aborted.
+ *
+ * Over TLS (and without sendfile) the file is read chunk by chunk with AsyncFile, so a slow disk never blocks the loop, and written through tryEnd/onWritable backpressure, like the
+ * VideoStreamer example does in JS. Over plain TCP on Linux the file data goes from the page cache straight to the socket with sendfile, only framing and the very last byte go
+ * through uWS so it keeps track of the response. File data may only bypass uWS while nothing is corked and uWS has nothing
+ * buffered, which a successful uncorked tryEnd right before proves. Everything that may run corked (the route handler,
+ * onWritable) hands over to a deferred call for that reason.
+ *
+ * TLS connections of a protocol with ktls are handed to the kernel at that point (KernelTLS), and then the same as TCP
+ * except that nothing at all may go through uWS anymore: framing is written to the socket directly, sendfile sends the
+ * last byte too and the response asks uWS to close the connection once it is over */
+template <bool SSL>
+struct FileStream {
+    static constexpr size_t chunkSize = 64 * 1024;
+
+    /* Bytes sent with sendfile before yielding to the loop, so one fast client can't starve the others */
+    static constexpr uint64_t sendfileBudget = 16 * 1024 * 1024;
+
+    uWS::HttpResponse<SSL> *res;
+    uv_loop_t *loop;
+    int fd;
+    ByteRanges ranges;
+    uint64_t totalSize;
+
+    /* File data may go to the socket with sendfile */
+    bool kernelWrites = false;
+
+    /* TLS records of this connection are encrypted by the kernel, everything goes to the socket directly */
+    bool kernelTLS = false;
+
+    /* Position within ranges, multipart bodies also frame each part and end with a trailer */
+    size_t part = 0;
+    uint64_t partOffset = 0;
+    bool partStarted = false;
+    bool trailerSent = false;
+
+    /* Produced but not yet written, starting at body offset chunkOffset */
+    std::string chunk;
+    uint64_t chunkOffset = 0;
+
+    /* The response is over but a deferred call or a read still points here */
+    bool deferred = false;
+    bool reading = false;
+    bool dead = false;
+
+    FileStream(uWS::HttpResponse<SSL> *res, uv_loop_t *loop, int fd, ByteRanges &&ranges, bool kernelWrites) : res(res), loop(loop), fd(fd), ranges(std::move(ranges)), kernelWrites(kernelWrites) {
+        /* A whole file is a single range without framing */
+        if (this->ranges.result != ByteRanges::PARTIAL) {
+            this->ranges.ranges = {{0, this->ranges.size}};
+        }
+        totalSize = this->ranges.contentLength();
+    }
+
+    ~FileStream() {
+        ::close(fd);
+    }
+
+    /* The TCP socket under the response */
+    static int socketFd(uWS::HttpResponse<SSL> *res) {
+        return (int) (uintptr_t) us_socket_get_native_handle(0, (us_socket_t *) res);
+    }
+
+    /* The BoringSSL connection under a TLS response */
+    static ::SSL *nativeSSL(uWS::HttpResponse<SSL> *res) {
+        return (::SSL *) us_socket_get_native_handle(1, (us_socket_t *) res);
+    }
+
+    /* Whether sendfile can be used. TLS records are encrypted in user space by uSockets, unless the protocol has ktls
+     * and the kernel knows the cipher */
+    static bool canSendfile(uWS::HttpResponse<SSL> *res, bool ktls) {
+#ifdef __linux__
+        if constexpr (SSL) {
+            return ktls && KernelTLS::supported(nativeSSL(res));
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /* Takes ownership of fd, writes the whole response. PARTIAL ranges get a 206, anything else is the whole file.
+     * kernelWrites is canSendfile. aborted (the user's abort handler, may be empty) runs if the client goes away before the end */
+    static void start(uWS::HttpResponse<SSL> *res, uv_loop_t *loop, int fd, ByteRanges &&ranges, bool kernelWrites, uWS::MoveOnlyFunction<void()> &&aborted = {}) {
+        if (ranges.result == ByteRanges::PARTIAL) {
+            ranges.writeHead(res);
+        } else if (!ranges.size) {
+            ::close(fd);
+            res->end();
+            return;
+        }
+
+        auto *stream = new FileStream(res, loop, fd, std::move(ranges), kernelWrites);
+
+        res->onAborted([stream, aborted = std::move(aborted)]() mutable {
+            stream->release();
+            if (aborted) {
+                aborted();
+            }
+        });
+        res->onWritable([stream](uint64_t offset) {
+            /* The read in flight continues by itself */
+            if (stream->reading) {
+                return true;
+            }
+            /* uWS has nothing of ours, what is left is still in chunk */
+            if (stream->kernelTLS) {
+                return stream->pump(false);
+            }
+            /* The unwritten part of the chunk goes first */
+            stream->chunk.erase(0, (size_t) (offset - stream->chunkOffset));
+            stream->chunkOffset = offset;
+            return stream->pump(false);
+        });
+
+        stream->pump(false);
+    }
+
+    void release() {
+        dead = true;
+        if (!deferred && !reading) {
+            delete this;
+        }
+    }
+
+    /* Continues with direct writes once the current callback (and its cork) is over */
+    void defer() {
+        if (deferred) {
+            return;
+        }
+        deferred = true;
+        uWS::Loop::get()->defer([this]() {
+            deferred = false;
+            if (dead) {
+                delete this;
+                return;
+            }
+            pump(true);
+        });
+    }
+
+    /* Adds the framing and up to limit bytes of file data that come next to chunk. The data is read asynchronously,
+     * pump continues once it is in */
+    void read(size_t limit) {
+        const ByteRanges::Range &range = ranges.ranges[part];
+        if (ranges.ranges.size() > 1 && !partStarted) {
+            chunk += ranges.partHeader(range);
+            partStarted = true;
+        }
+
+        size_t length = (size_t) std::min<uint64_t>(range.length - partOffset, limit);
+        size_t previous = chunk.length();
+        chunk.resize(previous + length);
+
+        reading = true;
+        AsyncFile::read(loop, fd, chunk.data() + previous, length, (int64_t) (range.start + partOffset), [this, previous](ssize_t n) {
+            reading = false;
+            if (dead) {
+                if (!deferred) {
+                    delete this;
+                }
+                return;
+            }
+
+            /* The file shrank or failed, the promised length can't be kept anymore */
+            if (n <= 0) {
+                res->close();
+                return;
+            }
+
+            chunk.resize(previous + (size_t) n);
+            advance((uint64_t) n);
+            addTrailer();
+
+            /* Completions come from libuv, nothing is corked here */
+            pump(kernelWrites);
+        });
+    }
+
+    /* The closing boundary of a multipart body once all parts are in, false if there is none (left) to add */
+    bool addTrailer() {
+        if (ranges.ranges.size() < 2 || part < ranges.ranges.size() || trailerSent) {
+            return false;
+        }
+        chunk += ranges.trailer();
+        trailerSent = true;
+        return true;
+    }
+
+    void advance(uint64_t length) {
+        partOffset += length;
+        if (partOffset == ranges.ranges[part].length) {
+            part++;
+            partOffset = 0;
+            partStarted = false;
+        }
+    }
+
+    /* Sends file data of the current part straight to the socket. Returns the bytes sent, 0 if the socket is full or the
+     * next bytes are framing or the last byte, -1 on failure */
+    ssize_t sendFile() {
+#ifdef __linux__
+        bool multipart = ranges.ranges.size() > 1;
+        if (part == ranges.ranges.size() || (multipart && !partStarted)) {
+            return 0;
+        }
+
+        const ByteRanges::Range &range = ranges.ranges[part];
+        uint64_t remaining = range.length - partOffset;
+        if (!multipart && !kernelTLS) {
+            remaining--;
+        }
+        if (!remaining) {
+            return 0;
+        }
+
+        off_t offset = (off_t) (range.start + partOffset);
+        ssize_t n = ::sendfile(socketFd(res), fd, &offset, (size_t) std::min<uint64_t>(remaining, sendfileBudget));
+        if (n < 0) {
+            return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        }
+        /* The file shrank */
+        if (n == 0) {
+            return -1;
+        }
+
+        res->overrideWriteOffset(res->getWriteOffset() + (uint64_t) n);
+        advance((uint64_t) n);
+
+        /* Starts reading ahead what the next burst sends, so sendfile finds it in the page cache instead of waiting for the disk */
+        if (part < ranges.ranges.size()) {
+            const ByteRanges::Range &next = ranges.ranges[part];
+            posix_fadvise(fd, (off_t) (next.start + partOffset), (off_t) std::min<uint64_t>(next.length - partOffset, sendfileBudget), POSIX_FADV_WILLNEED);
+        }
+        return n;
+#else
+        return 0;
+#endif
+    }
+
+    /* Writes until backpressure or the end, returns whether the last write went through.
+     * direct means we run uncorked, from a deferred call */
+    bool pump(bool direct) {
+        if (reading) {
+            return true;
+        }
+        if (kernelTLS) {
+            return pumpKernelTLS(direct);
+        }
+
+        bool verified = false;
+        uint64_t sent = 0;
+
+        while (true) {
+            if (chunk.empty()) {
+                if (kernelWrites) {
+                    if (!direct) {
+                        defer();
+                        return true;
+                    }
+
+                    if (verified) {
+                        /* Nothing is buffered, the connection can go to the kernel. If it can't, TLS stays in user space */
+                        if constexpr (SSL) {
+                            kernelTLS = KernelTLS::enableTx(nativeSSL(res), socketFd(res));
+                            if (!kernelTLS) {
+                                kernelWrites = false;
+                                continue;
+                            }
+                            return pumpKernelTLS(true);
+                        }
+
+                        if (sent >= sendfileBudget) {
+                            defer();
+                            return true;
+                        }
+
+                        ssize_t n = sendFile();
+                        if (n < 0) {
+                            res->close();
+                            return true;
+                        }
+                        if (n > 0) {
+                            sent += (uint64_t) n;
+                            continue;
+                        }
+                    }
+                }
+
+                /* Direct writes only need uWS for framing, the last byte and to learn when a full socket is writable again */
+                if (part < ranges.ranges.size()) {
+                    read(kernelWrites ? 1 : chunkSize);
+                    return true;
+                }
+                /* Everything is written but the response did not end */
+                if (!addTrailer()) {
+                    res->close();
+                    return true;
+                }
+            }
+
+            chunkOffset = res->getWriteOffset();
+            /* Headers go out with the first write, a connection that may be handed to the kernel can't be kept alive */
+            auto [ok, done] = res->tryEnd(chunk, totalSize, SSL && kernelWrites);
+            if (done) {
+                release();
+                return true;
+            }
+            if (!ok) {
+                return false;
+            }
+            chunk.clear();
+            verified = true;
+        }
+    }
+
+    /* After the handoff, framing and file data go to the socket directly. A full socket is left to a one byte write,
+     * which has uSockets wait for writable and call onWritable */
+    bool pumpKernelTLS(bool direct) {
+        uint64_t sent = 0;
+
+        while (true) {
+            if (chunk.length()) {
+                int written = us_socket_write(0, (us_socket_t *) res, chunk.data(), (int) chunk.length(), 0);
+                if (written > 0) {
+                    chunk.erase(0, (size_t) written);
+                    res->overrideWriteOffset(res->getWriteOffset() + (uint64_t) written);
+                }
+                if (chunk.length()) {
+                    /* What uWS does for a response that can't be written */
+                    us_socket_timeout(SSL, (us_socket_t *) res, 10);
+                    return false;
+                }
+                continue;
+            }
+
+            if (part < ranges.ranges.size()) {
+                if (ranges.ranges.size() > 1 && !partStarted) {
+                    chunk += ranges.partHeader(ranges.ranges[part]);
+                    partStarted = true;
+                    continue;
+                }
+                if (sent >= sendfileBudget) {
+                    defer();
+                    return true;
+                }
+
+                ssize_t n = sendFile();
+                if (n < 0) {
+                    res->close();
+                    return true;
+                }
+                if (n > 0) {
+                    sent += (uint64_t) n;
+                    continue;
+                }
+                read(1);
+                return true;
+            }
+
+            if (addTrailer()) {
+                continue;
+            }
+
+            /* uWS closes the connection only when the end isn't corked */
+            if (!direct) {
+                defer();
+                return true;
+            }
+            KernelTLS::sendCloseNotify(socketFd(res));
+            res->tryEnd({}, totalSize, true);
+            release();
+            return true;
+        }
+    }
+};
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <uv.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <limits.h>
+#endif
+
+#include "akeno/App.h"
+#include "akeno/external/ankerl/unordered_dense.h"
+
+/* Tells when watched files change, so caches don't have to stat() them per request. Watches the parent directories
+ * with inotify (editors and deploys replace files rather than write them in place), polled from the libuv loop.
+ * Without inotify, watch() always fails and callers keep checking freshness themselves */
+struct FileWatcher {
+    struct Directory {
+        int wd;
+        ankerl::unordered_dense::set<std::string> names;
+    };
+
+    int fd = -1;
+    uv_poll_t *poll = nullptr;
+    bool failed = false;
+
+    ankerl::unordered_dense::map<std::string, Directory> directories;
+    ankerl::unordered_dense::map<int, std::string> directoryByWd;
+
+    /* Called with the normalized path of each watched file that changed */
+    uWS::MoveOnlyFunction<void(const std::string &)> onChange;
+
+    ~FileWatcher() {
+        stop();
+    }
+
+    /* Paths are compared after this, watch() and onChange use the same form */
+    static std::string normalize(const std::string &path) {
+        std::error_code ec;
+        std::filesystem::path absolute = std::filesystem::absolute(path, ec);
+        return (ec ? std::filesystem::path(path) : absolute).lexically_normal().string();
+    }
+
+    /* Returns false if the file can't be watched */
+    bool watch(uv_loop_t *loop, const std::string &normalizedPath) {
+#ifdef __linux__
+        if (!start(loop)) {
+            return false;
+        }
+
+        std::filesystem::path path(normalizedPath);
+        std::string directory = path.parent_path().string();
+
+        auto it = directories.find(directory);
+        if (it == directories.end()) {
+            int wd = inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB | IN_ONLYDIR);
+            if (wd < 0) {
+                return false;
+            }
+            it = directories.emplace(directory, Directory{wd, {}}).first;
+            directoryByWd[wd] = directory;
+        }
+
+        it->second.names.insert(path.filename().string());
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool start(uv_loop_t *loop) {
+#ifdef __linux__
+        if (poll || failed) {
+            return !failed;
+        }
+
+        fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            failed = true;
+            return false;
+        }
+
+        poll = new uv_poll_t;
+        poll->data = this;
+        uv_poll_init(loop, poll, fd);
+        uv_poll_start(poll, UV_READABLE, [](uv_poll_t *handle, int status, int events) {
+            ((FileWatcher *) handle->data)->readEvents();
+        });
+        /* Watching alone never keeps the process alive */
+        uv_unref((uv_handle_t *) poll);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void readEvents() {
+#ifdef __linux__
+        alignas(struct inotify_event) char buffer[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+
+        while (true) {
+            ssize_t length = ::read(fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                return;
+            }
+
+            for (char *p = buffer; p < buffer + length; ) {
+                struct inotify_event *event = (struct inotify_event *) p;
+                p += sizeof(struct inotify_event) + event->len;
+
+                auto directory = directoryByWd.find(event->wd);
+                if (directory == directoryByWd.end()) {
+                    continue;
+                }
+                std::string directoryPath = directory->second;
+                Directory &watched = directories[directoryPath];
+
+                /* The directory itself is gone, so is everything in it */
+                if (event->mask & IN_IGNORED) {
+                    ankerl::unordered_dense::set<std::string> names = std::move(watched.names);
+                    directories.erase(directoryPath);
+                    directoryByWd.erase(event->wd);
+                    for (const std::string &name : names) {
+                        changed(directoryPath, name);
+                    }
+                    continue;
+                }
+
+                if (event->len && watched.names.contains(event->name)) {
+                    changed(directoryPath, event->name);
+                }
+            }
+        }
+#endif
+    }
+
+    /* A file reports a change once, whoever depends on it watches it again */
+    void changed(const std::string &directory, const std::string &name) {
+        auto it = directories.find(directory);
+        if (it != directories.end()) {
+            it->second.names.erase(name);
+        }
+        if (onChange) {
+            onChange((std::filesystem::path(directory) / name).string());
+        }
+    }
+
+    /* Must happen before the loop is freed */
+    void stop() {
+        if (poll) {
+            uv_poll_stop(poll);
+            uv_close((uv_handle_t *) poll, [](uv_handle_t *handle) {
+                delete (uv_poll_t *) handle;
+            });
+            poll = nullptr;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+        directories.clear();
+        directoryByWd.clear();
+    }
+};
@@ -4,10 +4,15 @@
 #include <string>
 #include <memory>
 #include <functional>
+#include <vector>
+#include <fstream>
+#include <sstream>
 
 #include <v8.h>
 #include <node_buffer.h>
 #include "Utilities.h"
+#include "CharScan.h"
+#include "BufferStream.h"
 
 #include "akeno/parser/x-parser.h"
 
@@ -26,6 +31,56 @@ struct HTMLParserUserData {
     }
 };
 
+struct HTMLParserWrapper;
+
+/* Lets sets and maps keyed by std::string be searched with the tokenizer's std::string_view as is */
+struct StringViewHash {
+    using is_transparent = void;
+    using is_avalanching = void;
+
+    auto operator()(std::string_view value) const noexcept {
+        return ankerl::unordered_dense::hash<std::string_view>{}(value);
+    }
+};
+
+/* A document parsed once, by parser.compile. The parser's own output is kept as is, every place a hook wrote to becomes a
+ * slot that render fills by calling that hook again. Pages that are mostly static then skip the tokenizer entirely */
+struct HTMLTemplate {
+    enum SlotType {
+        TEXT,
+        OPENING_TAG,
+        CLOSING_TAG,
+        INLINE
+    };
+
+    struct Slot {
+        /* Position in output */
+        size_t offset;
+        SlotType type;
+        /* What the hook got: the text or tag, and the enclosing tag */
+        std::string value;
+        std::string parentTag;
+        bool hasParent;
+    };
+
+    HTMLParserWrapper *parser = nullptr;
+    std::string output;
+    std::vector<Slot> slots;
+    /* A hook wrote outside of the output, which then can't be split into static runs and slots */
+    bool invalid = false;
+
+    /* Weak, deletes the template with its JS object */
+    Global<Object> object;
+
+    void addSlot(SlotType type, std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view value) {
+        if (&buffer != &output) {
+            invalid = true;
+            return;
+        }
+        slots.push_back({output.length(), type, std::string(value), tagStack.empty() ? std::string() : std::string(tagStack.top()), !tagStack.empty()});
+    }
+};
+
 struct HTMLParserWrapper {
     Isolate *isolate = nullptr;
     Akeno::HTMLParserOptions options;
@@ -37,6 +92,49 @@ struct HTMLParserWrapper {
     UniquePersistent<Function> onInlineRef;
     UniquePersistent<Function> onEndRef;
 
+    /* Set while compile runs, hooks then record slots instead of calling into JS and includes are collected to be watched */
+    HTMLTemplate *compiling = nullptr;
+    std::vector<std::string> compiledIncludes;
+
+    /* A tag handled natively instead of by the tag hooks, by what it does:
+     * TEXT appends the escaped value at a ctx.data path, INCLUDE inlines a file where it stands,
+     * IF and UNLESS keep what they enclose only if the ctx.data path is truthy (or falsy) */
+    struct Directive {
+        enum Type {
+            TEXT,
+            INCLUDE,
+            IF,
+            UNLESS
+        } type;
+        std::string value;
+        std::vector<std::string> path;
+    };
+
+    ankerl::unordered_dense::map<std::string, Directive, StringViewHash, std::equal_to<>> directives;
+
+    /* Tags that may call into JS, any if not filtered */
+    bool filterTags = false;
+    ankerl::unordered_dense::set<std::string, StringViewHash, std::equal_to<>> tagFilter;
+
+    /* The first include directive that failed in the current parse, the parse fails with it once done */
+    std::string includeError;
+
+    /* Open IF/UNLESS directives, by the buffer they write to */
+    struct Condition {
+        std::string *buffer;
+        size_t offset;
+        bool keep;
+        std::string tag;
+    };
+    std::vector<Condition> conditions;
+
+    /* Shared by every context object, render makes one per call */
+    Global<FunctionTemplate> ctxTemplate;
+
+    /* Files whose freshness the file watcher answers for (no stat in needsUpdate), and those that changed since */
+    ankerl::unordered_dense::set<std::string> watchedFiles;
+    ankerl::unordered_dense::set<std::string> changedFiles;
+
     HTMLParserWrapper(Isolate *isolate, Local<Object> opts)
         : isolate(isolate),
           options(getBoolOption(isolate, opts, "buffer", false)),
@@ -115,12 +213,17 @@ struct HTMLParserWrapper {
                     isScriptOrStyle = (top == "script" || top == "style");
                 }
 
-                bool hasAtSymbol = value.find('@') != std::string_view::npos;
+                bool hasAtSymbol = CharScan::contains<'@'>(value);
                 if (!hasAtSymbol && !isScriptOrStyle) {
                     buffer.append(value);
                     return;
                 }
 
+                if (compiling) {
+                    compiling->addSlot(HTMLTemplate::TEXT, buffer, tagStack, value);
+                    return;
+                }
+
                 Isolate *isolate = this->isolate;
                 HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
                 Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
@@ -153,117 +256,234 @@ struct HTMLParserWrapper {
             };
         });
 
-        attachCallback(opts, "onOpeningTag", onOpeningTagRef, [&](Local<Function> /*fn*/) {
+        attachCallback(opts, "onOpeningTag", onOpeningTagRef, [](Local<Function> /*fn*/) {});
+        attachCallback(opts, "onClosingTag", onClosingTagRef, [](Local<Function> /*fn*/) {});
+        attachCallback(opts, "onInline", onInlineRef, [](Local<Function> /*fn*/) {});
+        applyTagOptions(opts);
+
+        /* Tag hooks also run the directives, so they are there if either is */
+        if (!onOpeningTagRef.IsEmpty() || !directives.empty()) {
             options.onOpeningTag = [this](std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
-                if (userData == nullptr) {
+                onTag(HTMLTemplate::OPENING_TAG, buffer, tagStack, tag, userData);
+            };
+        }
+        if (!onClosingTagRef.IsEmpty() || !directives.empty()) {
+            options.onClosingTag = [this](std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
+                onTag(HTMLTemplate::CLOSING_TAG, buffer, tagStack, tag, userData);
+            };
+        }
+        if (!onInlineRef.IsEmpty() || !directives.empty()) {
+            options.onInline = [this](std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
+                onTag(HTMLTemplate::INLINE, buffer, tagStack, tag, userData);
+            };
+        }
+
+        attachCallback(opts, "onEnd", onEndRef, [&](Local<Function> /*fn*/) {
+            options.onEnd = [this](void *userData) {
+                /* render calls it once the template is filled */
+                if (userData == nullptr || compiling) {
                     return;
                 }
 
                 Isolate *isolate = this->isolate;
                 HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
                 Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
-                Local<Value> argv[3];
-                argv[0] = String::NewFromUtf8(isolate, tag.data(), NewStringType::kNormal, static_cast<int>(tag.size())).ToLocalChecked();
+                Local<Value> argv[1] = { ctxObj };
 
-                if (!tagStack.empty()) {
-                    const auto &top = tagStack.top();
-                    argv[1] = String::NewFromUtf8(isolate, top.data(), NewStringType::kNormal, static_cast<int>(top.size())).ToLocalChecked();
-                } else {
-                    argv[1] = Null(isolate);
-                }
+                Local<Function> cb = onEndRef.Get(isolate);
+                CallJS(isolate, cb, 1, argv);
+            };
+        });
+    }
 
-                argv[2] = ctxObj;
+    /* tags: [names] - only these tags call onOpeningTag, onClosingTag and onInline.
+     * directives: {tag: {text | include | if | unless: value}} - tags handled natively, see Directive */
+    void applyTagOptions(Local<Object> opts) {
+        Local<Context> context = isolate->GetCurrentContext();
 
-                Local<Function> cb = onOpeningTagRef.Get(isolate);
-                MaybeLocal<Value> maybeResult = CallJS(isolate, cb, 3, argv);
-                if (maybeResult.IsEmpty()) {
-                    return;
+        Local<Value> tagsValue;
+        if (opts->Get(context, String::NewFromUtf8(isolate, "tags", NewStringType::kNormal).ToLocalChecked()).ToLocal(&tagsValue) && tagsValue->IsArray()) {
+            Local<Array> tags = Local<Array>::Cast(tagsValue);
+            filterTags = true;
+            for (uint32_t i = 0; i < tags->Length(); i++) {
+                Local<Value> tag;
+                if (tags->Get(context, i).ToLocal(&tag) && tag->IsString()) {
+                    String::Utf8Value name(isolate, tag);
+                    tagFilter.emplace(*name, name.length());
                 }
+            }
+        }
 
-                Local<Value> result = maybeResult.ToLocalChecked();
-                appendResultToBuffer(isolate, result, buffer);
-            };
-        });
+        Local<Value> directivesValue;
+        if (!opts->Get(context, String::NewFromUtf8(isolate, "directives", NewStringType::kNormal).ToLocalChecked()).ToLocal(&directivesValue) || !directivesValue->IsObject()) {
+            return;
+        }
 
-        attachCallback(opts, "onClosingTag", onClosingTagRef, [&](Local<Function> /*fn*/) {
-            options.onClosingTag = [this](std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
-                if (userData == nullptr) {
-                    return;
+        Local<Object> directivesObject = Local<Object>::Cast(directivesValue);
+        Local<Array> names = directivesObject->GetOwnPropertyNames(context).ToLocalChecked();
+        for (uint32_t i = 0; i < names->Length(); i++) {
+            Local<Value> name = names->Get(context, i).ToLocalChecked();
+            Local<Value> definition = directivesObject->Get(context, name).ToLocalChecked();
+            if (!definition->IsObject()) {
+                continue;
+            }
+
+            static constexpr std::pair<const char *, Directive::Type> types[] = {
+                {"text", Directive::TEXT}, {"include", Directive::INCLUDE}, {"if", Directive::IF}, {"unless", Directive::UNLESS}
+            };
+            for (const auto &[key, type] : types) {
+                Local<Value> value;
+                if (!Local<Object>::Cast(definition)->Get(context, String::NewFromUtf8(isolate, key, NewStringType::kNormal).ToLocalChecked()).ToLocal(&value) || !value->IsString()) {
+                    continue;
                 }
 
-                Isolate *isolate = this->isolate;
-                HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
-                Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
-                Local<Value> argv[3];
-                argv[0] = String::NewFromUtf8(isolate, tag.data(), NewStringType::kNormal, static_cast<int>(tag.size())).ToLocalChecked();
+                String::Utf8Value tagName(isolate, name);
+                String::Utf8Value valueString(isolate, value);
+                Directive directive{type, std::string(*valueString, valueString.length()), {}};
 
-                if (!tagStack.empty()) {
-                    const auto &top = tagStack.top();
-                    argv[1] = String::NewFromUtf8(isolate, top.data(), NewStringType::kNormal, static_cast<int>(top.size())).ToLocalChecked();
-                } else {
-                    argv[1] = Null(isolate);
+                /* Paths into ctx.data are split once here */
+                std::string_view path = directive.value;
+                while (type != Directive::INCLUDE && path.length()) {
+                    size_t dot = path.find('.');
+                    directive.path.emplace_back(path.substr(0, dot));
+                    path = dot == std::string_view::npos ? std::string_view() : path.substr(dot + 1);
                 }
 
-                argv[2] = ctxObj;
+                directives[std::string(*tagName, tagName.length())] = std::move(directive);
+                break;
+            }
+        }
+    }
 
-                Local<Function> cb = onClosingTagRef.Get(isolate);
-                MaybeLocal<Value> maybeResult = CallJS(isolate, cb, 3, argv);
-                if (maybeResult.IsEmpty()) {
-                    return;
-                }
+    /* Whatever a tag hook is called with. Directives run natively and includes right away, even while compiling since
+     * they don't depend on data. Other tags call into JS, if they pass the tag filter */
+    void onTag(HTMLTemplate::SlotType type, std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
+        if (userData == nullptr) {
+            return;
+        }
 
-                Local<Value> result = maybeResult.ToLocalChecked();
-                appendResultToBuffer(isolate, result, buffer);
-            };
-        });
+        auto directive = directives.empty() ? directives.end() : directives.find(tag);
+        if (directive == directives.end() && (hookFor(type).IsEmpty() || (filterTags && !tagFilter.contains(tag)))) {
+            return;
+        }
 
-        attachCallback(opts, "onInline", onInlineRef, [&](Local<Function> /*fn*/) {
-            options.onInline = [this](std::string &buffer, std::stack<std::string_view> &tagStack, std::string_view tag, void *userData) {
-                if (userData == nullptr) {
-                    return;
+        if (directive != directives.end() && directive->second.type == Directive::INCLUDE) {
+            if (type != HTMLTemplate::CLOSING_TAG) {
+                if (compiling) {
+                    compiledIncludes.push_back(directive->second.value);
                 }
+                if (!ctx.inlineFile(directive->second.value) && includeError.empty()) {
+                    includeError = ctx.lastError.length() ? ctx.lastError : "Failed to include " + directive->second.value;
+                }
+            }
+            return;
+        }
 
-                Isolate *isolate = this->isolate;
-                HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
-                Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
-                Local<Value> argv[3];
-                argv[0] = String::NewFromUtf8(isolate, tag.data(), NewStringType::kNormal, static_cast<int>(tag.size())).ToLocalChecked();
+        if (compiling) {
+            compiling->addSlot(type, buffer, tagStack, tag);
+            return;
+        }
 
-                if (!tagStack.empty()) {
-                    const auto &top = tagStack.top();
-                    argv[1] = String::NewFromUtf8(isolate, top.data(), NewStringType::kNormal, static_cast<int>(top.size())).ToLocalChecked();
-                } else {
-                    argv[1] = Null(isolate);
-                }
+        HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
+        Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
+        if (tagStack.empty()) {
+            runTag(type, buffer, tag, false, {}, ctxObj);
+        } else {
+            runTag(type, buffer, tag, true, tagStack.top(), ctxObj);
+        }
+    }
 
-                argv[2] = ctxObj;
+    /* What a tag does once there is a context, for parsing and for filling template slots alike */
+    void runTag(HTMLTemplate::SlotType type, std::string &buffer, std::string_view tag, bool hasParent, std::string_view parentTag, Local<Object> ctxObj) {
+        auto directive = directives.empty() ? directives.end() : directives.find(tag);
+        if (directive != directives.end()) {
+            runDirective(directive->second, type, buffer, tag, ctxObj);
+            return;
+        }
 
-                Local<Function> cb = onInlineRef.Get(isolate);
-                MaybeLocal<Value> maybeResult = CallJS(isolate, cb, 3, argv);
-                if (maybeResult.IsEmpty()) {
-                    return;
-                }
+        Local<Value> argv[3];
+        argv[0] = String::NewFromUtf8(isolate, tag.data(), NewStringType::kNormal, static_cast<int>(tag.size())).ToLocalChecked();
+        argv[1] = hasParent ? String::NewFromUtf8(isolate, parentTag.data(), NewStringType::kNormal, static_cast<int>(parentTag.size())).ToLocalChecked().As<Value>() : Null(isolate).As<Value>();
+        argv[2] = ctxObj;
 
-                Local<Value> result = maybeResult.ToLocalChecked();
-                appendResultToBuffer(isolate, result, buffer);
-            };
-        });
+        MaybeLocal<Value> maybeResult = CallJS(isolate, hookFor(type).Get(isolate), 3, argv);
+        if (maybeResult.IsEmpty()) {
+            return;
+        }
+        appendResultToBuffer(isolate, maybeResult.ToLocalChecked(), buffer);
+    }
 
-        attachCallback(opts, "onEnd", onEndRef, [&](Local<Function> /*fn*/) {
-            options.onEnd = [this](void *userData) {
-                if (userData == nullptr) {
+    /* ctx.data at a path, undefined if any part of it is missing */
+    Local<Value> lookupData(Local<Object> ctxObj, const std::vector<std::string> &path) {
+        Local<Context> context = isolate->GetCurrentContext();
+        Local<Value> value;
+        if (!ctxObj->Get(context, String::NewFromUtf8(isolate, "data", NewStringType::kNormal).ToLocalChecked()).ToLocal(&value)) {
+            return Undefined(isolate);
+        }
+
+        for (const std::string &key : path) {
+            if (!value->IsObject() || !Local<Object>::Cast(value)->Get(context, String::NewFromUtf8(isolate, key.data(), NewStringType::kNormal, static_cast<int>(key.size())).ToLocalChecked()).ToLocal(&value)) {
+                return Undefined(isolate);
+            }
+        }
+        return value;
+    }
+
+    void runDirective(const Directive &directive, HTMLTemplate::SlotType type, std::string &buffer, std::string_view tag, Local<Object> ctxObj) {
+        switch (directive.type) {
+            case Directive::TEXT: {
+                if (type == HTMLTemplate::CLOSING_TAG) {
                     return;
                 }
+                Local<Value> value = lookupData(ctxObj, directive.path);
+                if (value->IsNullOrUndefined()) {
+                    return;
+                }
+                String::Utf8Value text(isolate, value);
+                appendEscaped(buffer, std::string_view(*text ? *text : "", text.length()));
+                return;
+            }
+            case Directive::IF:
+            case Directive::UNLESS: {
+                /* Whatever the tag encloses is dropped again when it closes, if the condition does not hold */
+                if (type == HTMLTemplate::OPENING_TAG) {
+                    bool keep = lookupData(ctxObj, directive.path)->BooleanValue(isolate) == (directive.type == Directive::IF);
+                    conditions.push_back({&buffer, buffer.length(), keep, std::string(tag)});
+                } else if (type == HTMLTemplate::CLOSING_TAG) {
+                    for (size_t i = conditions.size(); i-- > 0;) {
+                        if (conditions[i].buffer == &buffer && conditions[i].tag == tag) {
+                            if (!conditions[i].keep && buffer.length() >= conditions[i].offset) {
+                                buffer.resize(conditions[i].offset);
+                            }
+                            conditions.erase(conditions.begin() + (std::ptrdiff_t) i);
+                            break;
+                        }
+                    }
+                }
+                return;
+            }
+            default:
+                return;
+        }
+    }
 
-                Isolate *isolate = this->isolate;
-                HTMLParserUserData *ctxUser = static_cast<HTMLParserUserData *>(userData);
-                Local<Object> ctxObj = Local<Object>::New(isolate, ctxUser->ctxObject);
-                Local<Value> argv[1] = { ctxObj };
-
-                Local<Function> cb = onEndRef.Get(isolate);
-                CallJS(isolate, cb, 1, argv);
-            };
-        });
+    static void appendEscaped(std::string &buffer, std::string_view text) {
+        size_t start = 0;
+        for (size_t i = 0; i < text.length(); i++) {
+            std::string_view entity;
+            switch (text[i]) {
+                case '&': entity = "&amp;"; break;
+                case '<': entity = "&lt;"; break;
+                case '>': entity = "&gt;"; break;
+                case '"': entity = "&quot;"; break;
+                case '\'': entity = "&#39;"; break;
+                default: continue;
+            }
+            buffer.append(text.substr(start, i - start));
+            buffer.append(entity);
+            start = i + 1;
+        }
+        buffer.append(text.substr(start));
     }
 
     static bool appendResultToBuffer(Isolate *isolate, Local<Value> value, std::string &buffer) {
@@ -292,6 +512,30 @@ struct HTMLParserWrapper {
         return false;
     }
 
+    /* A failed include fails the whole parse with its error in ctx.lastError, like context.import throws it */
+    bool finishParse(bool ok) {
+        if (ok && includeError.length()) {
+            ctx.lastError = std::move(includeError);
+            ok = false;
+        }
+        includeError.clear();
+        return ok;
+    }
+
+    /* Whether parsing may run JS, through hooks or ctx.data lookups */
+    bool callsIntoJS() const {
+        return !onTextRef.IsEmpty() || !onOpeningTagRef.IsEmpty() || !onClosingTagRef.IsEmpty() || !onInlineRef.IsEmpty() || !onEndRef.IsEmpty() || !directives.empty();
+    }
+
+    UniquePersistent<Function> &hookFor(HTMLTemplate::SlotType type) {
+        switch (type) {
+            case HTMLTemplate::OPENING_TAG: return onOpeningTagRef;
+            case HTMLTemplate::CLOSING_TAG: return onClosingTagRef;
+            case HTMLTemplate::INLINE: return onInlineRef;
+            default: return onTextRef;
+        }
+    }
+
     template <typename T>
     void attachCallback(Local<Object> opts, const char *name, UniquePersistent<Function> &storage, T attach) {
         Local<Context> context = isolate->GetCurrentContext();
@@ -311,6 +555,19 @@ struct HTMLParserWrapper {
     }
 };
 
+/* Hands a result to JS as a Buffer over its own memory, without copying it. The Buffer owns it from here */
+static MaybeLocal<Object> newExternalBuffer(Isolate *isolate, std::string &&result) {
+    auto *storage = new std::string(std::move(result));
+    return node::Buffer::New(
+        isolate,
+        storage->data(),
+        storage->size(),
+        [](char *data, void *hint) {
+            delete static_cast<std::string *>(hint);
+        },
+        storage);
+}
+
 static inline void ThrowTypeError(Isolate *isolate, const char *message) {
     isolate->ThrowException(Exception::TypeError(String::NewFromUtf8(isolate, message, NewStringType::kNormal).ToLocalChecked()));
 }
@@ -404,6 +661,31 @@ static void Akeno_HTMLParser_context_import(const FunctionCallbackInfo<Value> &a
     }
 }
 
+/* A ParserContext with data as ctx.data, hooks get it as their last argument */
+static Local<Object> newParserContext(Isolate *isolate, HTMLParserWrapper *parser, Local<Object> dataObject) {
+    if (parser->ctxTemplate.IsEmpty()) {
+        Local<FunctionTemplate> ctxTemplate = FunctionTemplate::New(isolate);
+        ctxTemplate->SetClassName(String::NewFromUtf8(isolate, "HTMLParserContext", NewStringType::kNormal).ToLocalChecked());
+        ctxTemplate->InstanceTemplate()->SetInternalFieldCount(1);
+        ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "write", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_write));
+        ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onText", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_write));
+        ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getTagName", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_getTagName));
+        ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "setBodyAttributes", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_setBodyAttributes));
+        ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "import", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_import));
+        parser->ctxTemplate.Reset(isolate, ctxTemplate);
+    }
+
+    Local<Object> ctxObject = parser->ctxTemplate.Get(isolate)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()
+        ->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
+
+    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "data", NewStringType::kNormal).ToLocalChecked(), dataObject).ToChecked();
+    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "embedded", NewStringType::kNormal).ToLocalChecked(), Boolean::New(isolate, true)).ToChecked();
+    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "strict", NewStringType::kNormal).ToLocalChecked(), Boolean::New(isolate, false)).ToChecked();
+
+    ctxObject->SetAlignedPointerInInternalField(0, parser);
+    return ctxObject;
+}
+
 static void Akeno_HTMLParser_createContext(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
     HTMLParserWrapper *parser = getParserWrapper(args);
@@ -413,18 +695,6 @@ static void Akeno_HTMLParser_createContext(const FunctionCallbackInfo<Value> &ar
         return;
     }
 
-    Local<FunctionTemplate> ctxTemplate = FunctionTemplate::New(isolate);
-    ctxTemplate->SetClassName(String::NewFromUtf8(isolate, "HTMLParserContext", NewStringType::kNormal).ToLocalChecked());
-    ctxTemplate->InstanceTemplate()->SetInternalFieldCount(1);
-    ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "write", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_write));
-    ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onText", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_write));
-    ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getTagName", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_getTagName));
-    ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "setBodyAttributes", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_setBodyAttributes));
-    ctxTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "import", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_context_import));
-
-    Local<Object> ctxObject = ctxTemplate->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()
-        ->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
-
     Local<Object> dataObject;
     if (args.Length() > 0 && args[0]->IsObject()) {
         dataObject = Local<Object>::Cast(args[0]);
@@ -432,12 +702,7 @@ static void Akeno_HTMLParser_createContext(const FunctionCallbackInfo<Value> &ar
         dataObject = Object::New(isolate);
     }
 
-    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "data", NewStringType::kNormal).ToLocalChecked(), dataObject).ToChecked();
-    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "embedded", NewStringType::kNormal).ToLocalChecked(), Boolean::New(isolate, true)).ToChecked();
-    ctxObject->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "strict", NewStringType::kNormal).ToLocalChecked(), Boolean::New(isolate, false)).ToChecked();
-
-    ctxObject->SetAlignedPointerInInternalField(0, parser);
-    args.GetReturnValue().Set(ctxObject);
+    args.GetReturnValue().Set(newParserContext(isolate, parser, dataObject));
 }
 
 static void Akeno_HTMLParser_fromStringInternal(const FunctionCallbackInfo<Value> &args, bool isMarkdown) {
@@ -449,27 +714,42 @@ static void Akeno_HTMLParser_fromStringInternal(const FunctionCallbackInfo<Value
         return;
     }
 
-    if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsObject()) {
-        ThrowTypeError(isolate, "Expected a string and a ParserContext instance");
+    if (args.Length() < 2 || !args[1]->IsObject()) {
+        ThrowTypeError(isolate, "Expected a string or a buffer and a ParserContext instance");
         return;
     }
 
-    String::Utf8Value input(isolate, args[0]);
-    std::string source(*input ? *input : "", input.length());
+    /* Buffers and external strings are parsed in place. A hook (or a getter reached by a directive) could write to a
+     * buffer while the parser still points into it, so buffers are only read in place when no JS runs during the parse */
+    NativeString input(isolate, args[0]);
+    if (input.isInvalid(args)) {
+        return;
+    }
     Local<Object> ctxObject = Local<Object>::Cast(args[1]);
 
+    std::string inputCopy;
+    std::string_view source = input.getString();
+    if (input.isBuffer() && parser->callsIntoJS()) {
+        inputCopy.assign(source);
+        source = inputCopy;
+    }
+
     std::string result;
     HTMLParserUserData userData(isolate, ctxObject);
 
     parser->ctx.in_markdown = isMarkdown;
+    parser->conditions.clear();
 
-    if (!parser->ctx.write(source, &result, &userData)) {
+    bool ok = parser->ctx.write(source, &result, &userData);
+    if (ok) {
+        parser->ctx.end();
+    }
+    if (!parser->finishParse(ok)) {
         isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, parser->ctx.lastError.c_str(), NewStringType::kNormal).ToLocalChecked()));
         return;
     }
-    parser->ctx.end();
 
-    auto maybeBuffer = node::Buffer::Copy(isolate, result.data(), result.size());
+    auto maybeBuffer = newExternalBuffer(isolate, std::move(result));
     if (maybeBuffer.IsEmpty()) {
         args.GetReturnValue().Set(Undefined(isolate));
         return;
@@ -478,6 +758,72 @@ static void Akeno_HTMLParser_fromStringInternal(const FunctionCallbackInfo<Value
     args.GetReturnValue().Set(maybeBuffer.ToLocalChecked());
 }
 
+/* Parses a file with ctxObject as the context (ctx.data.path is the app path), the arguments after it are sanitize and
+ * template like in fromFile. Throws and returns nullptr on failure */
+static Akeno::FileCache::CacheEntry *parseFileWithContext(const FunctionCallbackInfo<Value> &args, HTMLParserWrapper *parser, const std::string &filePath, Local<Object> ctxObject, int optionsIndex, bool isMarkdown) {
+    Isolate *isolate = args.GetIsolate();
+
+    std::string appPath;
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<Value> dataValue = ctxObject->Get(context, String::NewFromUtf8(isolate, "data", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked();
+    if (dataValue->IsObject()) {
+        Local<Object> dataObj = Local<Object>::Cast(dataValue);
+        Local<Value> pathValue = dataObj->Get(context, String::NewFromUtf8(isolate, "path", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked();
+        if (pathValue->IsString()) {
+            String::Utf8Value appPathStr(isolate, pathValue);
+            appPath.assign(*appPathStr ? *appPathStr : "", appPathStr.length());
+        }
+    }
+
+    parser->ctx.in_markdown = isMarkdown;
+    parser->ctx.sanitize_html = (args.Length() > optionsIndex && args[optionsIndex]->IsBoolean()) ? args[optionsIndex]->BooleanValue(isolate) : false;
+    parser->ctx.template_enabled = (args.Length() > optionsIndex + 1 && args[optionsIndex + 1]->IsBoolean()) ? args[optionsIndex + 1]->BooleanValue(isolate) : false;
+
+    HTMLParserUserData userData(isolate, ctxObject);
+    parser->conditions.clear();
+    Akeno::FileCache::CacheEntry *cache = parser->ctx.fromFile(filePath, &userData, appPath);
+    if (!parser->finishParse(cache != nullptr)) {
+        isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, parser->ctx.lastError.c_str(), NewStringType::kNormal).ToLocalChecked()));
+        return nullptr;
+    }
+
+    /* Watch the file and everything it includes, needsUpdate only has to stat if any of them can't be watched */
+    if (args.Data()->IsExternal()) {
+        auto *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+        bool watched = addFileDependent(perContextData, filePath, {nullptr, &parser->changedFiles, filePath});
+        if (cache->shared) {
+            for (const auto &pathInfo : cache->shared->paths) {
+                watched = addFileDependent(perContextData, pathInfo.path, {nullptr, &parser->changedFiles, filePath}) && watched;
+            }
+        }
+
+        parser->changedFiles.erase(filePath);
+        if (watched) {
+            parser->watchedFiles.insert(filePath);
+        } else {
+            parser->watchedFiles.erase(filePath);
+        }
+    }
+
+    return cache;
+}
+
+/* The files a parsed file was built from, as returned next to the result */
+static Local<Array> getLinkedPaths(Isolate *isolate, Akeno::FileCache::CacheEntry *cache) {
+    if (!cache || !cache->shared) {
+        return Array::New(isolate, 0);
+    }
+
+    const auto &paths = cache->shared->paths;
+    Local<Array> pathsArray = Array::New(isolate, static_cast<int>(paths.size()));
+    for (size_t i = 0; i < paths.size(); ++i) {
+        const auto &pathInfo = paths[i];
+        Local<String> pathValue = String::NewFromUtf8(isolate, pathInfo.path.data(), NewStringType::kNormal, static_cast<int>(pathInfo.path.size())).ToLocalChecked();
+        pathsArray->Set(isolate->GetCurrentContext(), static_cast<uint32_t>(i), pathValue).ToChecked();
+    }
+    return pathsArray;
+}
+
 static void Akeno_HTMLParser_fromFileInternal(const FunctionCallbackInfo<Value> &args, bool isMarkdown) {
     Isolate *isolate = args.GetIsolate();
     HTMLParserWrapper *parser = getParserWrapper(args);
@@ -496,66 +842,89 @@ static void Akeno_HTMLParser_fromFileInternal(const FunctionCallbackInfo<Value>
     std::string filePath(*path ? *path : "", path.length());
     Local<Object> ctxObject = Local<Object>::Cast(args[1]);
 
-    std::string appPath;
-    Local<Context> context = isolate->GetCurrentContext();
-    Local<Value> dataValue = ctxObject->Get(context, String::NewFromUtf8(isolate, "data", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked();
-    if (dataValue->IsObject()) {
-        Local<Object> dataObj = Local<Object>::Cast(dataValue);
-        Local<Value> pathValue = dataObj->Get(context, String::NewFromUtf8(isolate, "path", NewStringType::kNormal).ToLocalChecked()).ToLocalChecked();
-        if (pathValue->IsString()) {
-            String::Utf8Value appPathStr(isolate, pathValue);
-            appPath.assign(*appPathStr ? *appPathStr : "", appPathStr.length());
-        }
+    Akeno::FileCache::CacheEntry *cache = parseFileWithContext(args, parser, filePath, ctxObject, 2, isMarkdown);
+    if (!cache) {
+        return;
     }
 
-    parser->ctx.in_markdown = isMarkdown;
-    parser->ctx.sanitize_html = (args.Length() > 2 && args[2]->IsBoolean()) ? args[2]->BooleanValue(isolate) : false;
-    parser->ctx.template_enabled = (args.Length() > 3 && args[3]->IsBoolean()) ? args[3]->BooleanValue(isolate) : false;
-
-    HTMLParserUserData userData(isolate, ctxObject);
-    Akeno::FileCache::CacheEntry *cache = nullptr;
+    auto maybeBuffer = newExternalBuffer(isolate, parser->ctx.exportCopy(cache));
 
-    cache = parser->ctx.fromFile(filePath, &userData, appPath);
-    if (!cache) {
-        isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, parser->ctx.lastError.c_str(), NewStringType::kNormal).ToLocalChecked()));
+    if (maybeBuffer.IsEmpty()) {
+        args.GetReturnValue().Set(Undefined(isolate));
         return;
     }
 
-    auto resultPtr = std::make_shared<std::string>(std::move(parser->ctx.exportCopy(cache)));
-    auto *storage = new std::shared_ptr<std::string>(std::move(resultPtr));
+    Local<Array> result = Array::New(isolate, 2);
+    result->Set(isolate->GetCurrentContext(), 0, maybeBuffer.ToLocalChecked()).ToChecked();
+    result->Set(isolate->GetCurrentContext(), 1, getLinkedPaths(isolate, cache)).ToChecked();
+    args.GetReturnValue().Set(result);
+}
 
-    auto maybeBuffer = node::Buffer::New(
-        isolate,
-        const_cast<char *>((*storage)->data()),
-        (*storage)->size(),
-        [](char *data, void *hint) {
-            auto *sp = static_cast<std::shared_ptr<std::string> *>(hint);
-            delete sp;
-        },
-        storage);
+/* parser.renderTo(res, path, ctx, [sanitize], [template]) - Like fromFile, but the result goes straight into the response
+ * instead of through a Buffer and res.end. The body is written with backpressure and ends the response, returns the
+ * linked paths. Set status and headers before */
+static void Akeno_HTMLParser_renderTo(const FunctionCallbackInfo<Value> &args) {
+    Isolate *isolate = args.GetIsolate();
+    HTMLParserWrapper *parser = getParserWrapper(args);
 
-    if (maybeBuffer.IsEmpty()) {
-        args.GetReturnValue().Set(Undefined(isolate));
+    if (!parser) {
+        ThrowTypeError(isolate, "Parser instance is not initialized.");
         return;
     }
 
-    Local<Array> pathsArray;
-    if (cache && cache->shared) {
-        const auto &paths = cache->shared->paths;
-        pathsArray = Array::New(isolate, static_cast<int>(paths.size()));
-        for (size_t i = 0; i < paths.size(); ++i) {
-            const auto &pathInfo = paths[i];
-            Local<String> pathValue = String::NewFromUtf8(isolate, pathInfo.path.data(), NewStringType::kNormal, static_cast<int>(pathInfo.path.size())).ToLocalChecked();
-            pathsArray->Set(isolate->GetCurrentContext(), static_cast<uint32_t>(i), pathValue).ToChecked();
+    if (args.Length() < 3 || !args[0]->IsObject() || !args[1]->IsString() || !args[2]->IsObject()) {
+        ThrowTypeError(isolate, "Expected an HttpResponse, a string and a ParserContext instance");
+        return;
+    }
+
+    auto *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+    Local<Object> resObject = Local<Object>::Cast(args[0]);
+
+    /* Responses are clones of the per-protocol templates, the prototype tells them apart */
+    int protocol = -1;
+    for (int i = 0; i < 2; i++) {
+        if (resObject->GetPrototype()->StrictEquals(perContextData->resTemplate[i].Get(isolate)->GetPrototype())) {
+            protocol = i;
         }
+    }
+    if (protocol < 0 || resObject->InternalFieldCount() < 1) {
+        ThrowTypeError(isolate, "renderTo() expects an HttpResponse of an App or SSLApp");
+        return;
+    }
+
+    void *res = resObject->GetAlignedPointerFromInternalField(0);
+    if (!res) {
+        isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "uWS.HttpResponse must not be accessed after uWS.HttpResponse.onAborted callback, or after a successful response.", NewStringType::kNormal).ToLocalChecked()));
+        return;
+    }
+
+    String::Utf8Value path(isolate, args[1]);
+    std::string filePath(*path ? *path : "", path.length());
+
+    Akeno::FileCache::CacheEntry *cache = parseFileWithContext(args, parser, filePath, Local<Object>::Cast(args[2]), 3, false);
+    if (!cache) {
+        return;
+    }
+
+    std::string body = parser->ctx.exportCopy(cache);
+
+    /* renderTo ends the response */
+    resObject->SetAlignedPointerInInternalField(0, nullptr);
+    uWS::MoveOnlyFunction<void()> aborted = HttpResponseWrapper::takeAbortHandler(isolate, resObject);
+
+    if (protocol == 1) {
+        auto *sslRes = (uWS::HttpResponse<true> *) res;
+        sslRes->cork([&]() {
+            BufferStream<true>::start(sslRes, std::move(body), std::move(aborted));
+        });
     } else {
-        pathsArray = Array::New(isolate, 0);
+        auto *tcpRes = (uWS::HttpResponse<false> *) res;
+        tcpRes->cork([&]() {
+            BufferStream<false>::start(tcpRes, std::move(body), std::move(aborted));
+        });
     }
 
-    Local<Array> result = Array::New(isolate, 2);
-    result->Set(isolate->GetCurrentContext(), 0, maybeBuffer.ToLocalChecked()).ToChecked();
-    result->Set(isolate->GetCurrentContext(), 1, pathsArray).ToChecked();
-    args.GetReturnValue().Set(result);
+    args.GetReturnValue().Set(getLinkedPaths(isolate, cache));
 }
 
 static void Akeno_HTMLParser_fromString(const FunctionCallbackInfo<Value> &args) {
@@ -574,6 +943,183 @@ static void Akeno_HTMLParser_fromMarkdownFile(const FunctionCallbackInfo<Value>
     Akeno_HTMLParser_fromFileInternal(args, true);
 }
 
+/* template.render([data]) - Fills the slots of a compiled template, hooks get a fresh context with data as ctx.data */
+static void Akeno_HTMLTemplate_render(const FunctionCallbackInfo<Value> &args) {
+    Isolate *isolate = args.GetIsolate();
+    HTMLTemplate *compiled = static_cast<HTMLTemplate *>(args.This()->GetAlignedPointerFromInternalField(0));
+
+    if (!compiled) {
+        ThrowTypeError(isolate, "Template is not initialized.");
+        return;
+    }
+
+    HTMLParserWrapper *parser = compiled->parser;
+    Local<Object> dataObject = (args.Length() > 0 && args[0]->IsObject()) ? Local<Object>::Cast(args[0]) : Object::New(isolate);
+    Local<Object> ctxObject = newParserContext(isolate, parser, dataObject);
+
+    std::string result;
+    result.reserve(compiled->output.length() + compiled->slots.size() * 32);
+
+    /* ctx.write appends where the slot is being filled */
+    std::string *previousOutput = parser->ctx.output;
+    parser->ctx.output = &result;
+    parser->conditions.clear();
+
+    size_t offset = 0;
+    for (const HTMLTemplate::Slot &slot : compiled->slots) {
+        result.append(compiled->output, offset, slot.offset - offset);
+        offset = slot.offset;
+
+        if (slot.type != HTMLTemplate::TEXT) {
+            parser->runTag(slot.type, result, slot.value, slot.hasParent, slot.parentTag, ctxObject);
+            continue;
+        }
+
+        UniquePersistent<Function> &hook = parser->hookFor(slot.type);
+        if (hook.IsEmpty()) {
+            continue;
+        }
+
+        Local<Value> argv[3];
+        argv[0] = String::NewFromUtf8(isolate, slot.value.data(), NewStringType::kNormal, static_cast<int>(slot.value.size())).ToLocalChecked();
+        argv[1] = slot.hasParent ? String::NewFromUtf8(isolate, slot.parentTag.data(), NewStringType::kNormal, static_cast<int>(slot.parentTag.size())).ToLocalChecked().As<Value>() : Null(isolate).As<Value>();
+        argv[2] = ctxObject;
+
+        MaybeLocal<Value> maybeResult = CallJS(isolate, hook.Get(isolate), 3, argv);
+        if (maybeResult.IsEmpty()) {
+            continue;
+        }
+
+        Local<Value> value = maybeResult.ToLocalChecked();
+        if (!HTMLParserWrapper::appendResultToBuffer(isolate, value, result) && value->IsBoolean() && value->BooleanValue(isolate)) {
+            result.append(slot.value);
+        }
+    }
+    result.append(compiled->output, offset);
+
+    if (!parser->onEndRef.IsEmpty()) {
+        Local<Value> argv[1] = { ctxObject };
+        CallJS(isolate, parser->onEndRef.Get(isolate), 1, argv);
+    }
+
+    parser->ctx.output = previousOutput;
+
+    auto maybeBuffer = newExternalBuffer(isolate, std::move(result));
+    if (maybeBuffer.IsEmpty()) {
+        args.GetReturnValue().Set(Undefined(isolate));
+        return;
+    }
+
+    args.GetReturnValue().Set(maybeBuffer.ToLocalChecked());
+}
+
+/* The object compile results are cloned from, created once per context */
+static Local<Object> initHTMLTemplate(Isolate *isolate) {
+    Local<FunctionTemplate> templateTemplate = FunctionTemplate::New(isolate);
+    templateTemplate->SetClassName(String::NewFromUtf8(isolate, "HTMLTemplate", NewStringType::kNormal).ToLocalChecked());
+    templateTemplate->InstanceTemplate()->SetInternalFieldCount(1);
+    templateTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "render", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLTemplate_render));
+
+    Local<Object> templateObject = templateTemplate->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()
+        ->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
+    templateObject->SetAlignedPointerInInternalField(0, nullptr);
+    return templateObject;
+}
+
+/* parser.compile(pathOrString, [isFile], [isMarkdown], [sanitize], [template]) - Parses once and returns a template to
+ * render many times. Compiled files and what they include are watched like fromFile, needsUpdate(path) tells when to compile again.
+ * Files are read synchronously, compile belongs at startup and after needsUpdate, render is what runs per request */
+static void Akeno_HTMLParser_compile(const FunctionCallbackInfo<Value> &args) {
+    Isolate *isolate = args.GetIsolate();
+    HTMLParserWrapper *parser = getParserWrapper(args);
+
+    if (!parser) {
+        ThrowTypeError(isolate, "Parser instance is not initialized.");
+        return;
+    }
+
+    if (args.Length() < 1 || !args[0]->IsString()) {
+        ThrowTypeError(isolate, "Expected a string");
+        return;
+    }
+
+    String::Utf8Value input(isolate, args[0]);
+    std::string source(*input ? *input : "", input.length());
+    bool isFile = args.Length() > 1 && args[1]->BooleanValue(isolate);
+    bool isMarkdown = args.Length() > 2 && args[2]->BooleanValue(isolate);
+
+    std::string filePath;
+    if (isFile) {
+        filePath = std::move(source);
+        std::ifstream file(filePath, std::ios::binary);
+        if (!file) {
+            isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, ("Failed to open file: " + filePath).c_str(), NewStringType::kNormal).ToLocalChecked()));
+            return;
+        }
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        source = std::move(contents).str();
+    }
+
+    auto compiled = std::make_unique<HTMLTemplate>();
+    compiled->parser = parser;
+
+    /* Hooks only run with user data, they record slots while compiling instead of using it */
+    HTMLParserUserData userData(isolate, newParserContext(isolate, parser, Object::New(isolate)));
+    parser->ctx.in_markdown = isMarkdown;
+    parser->ctx.sanitize_html = args.Length() > 3 && args[3]->IsBoolean() && args[3]->BooleanValue(isolate);
+    parser->ctx.template_enabled = args.Length() > 4 && args[4]->IsBoolean() && args[4]->BooleanValue(isolate);
+    parser->conditions.clear();
+    parser->compiledIncludes.clear();
+    parser->compiling = compiled.get();
+    bool ok = parser->ctx.write(source, &compiled->output, &userData);
+    if (ok) {
+        parser->ctx.end();
+    }
+    parser->compiling = nullptr;
+    ok = parser->finishParse(ok);
+
+    if (!ok) {
+        isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, parser->ctx.lastError.c_str(), NewStringType::kNormal).ToLocalChecked()));
+        return;
+    }
+
+    if (compiled->invalid) {
+        isolate->ThrowException(Exception::Error(String::NewFromUtf8(isolate, "This document can't be compiled, use fromString or fromFile instead", NewStringType::kNormal).ToLocalChecked()));
+        return;
+    }
+
+    if (isFile && args.Data()->IsExternal()) {
+        auto *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+        bool watched = addFileDependent(perContextData, filePath, {nullptr, &parser->changedFiles, filePath});
+        for (const std::string &includedPath : parser->compiledIncludes) {
+            watched = addFileDependent(perContextData, includedPath, {nullptr, &parser->changedFiles, filePath}) && watched;
+        }
+
+        parser->changedFiles.erase(filePath);
+        if (watched) {
+            parser->watchedFiles.insert(filePath);
+        } else {
+            parser->watchedFiles.erase(filePath);
+        }
+    }
+
+    Local<Object> templateObject = args.Data()->IsExternal()
+        ? ((PerContextData *) Local<External>::Cast(args.Data())->Value())->htmlTemplate.Get(isolate)->Clone()
+        : initHTMLTemplate(isolate);
+
+    HTMLTemplate *templatePtr = compiled.release();
+    templateObject->SetAlignedPointerInInternalField(0, templatePtr);
+    templatePtr->object.Reset(isolate, templateObject);
+    templatePtr->object.SetWeak(templatePtr, [](const WeakCallbackInfo<HTMLTemplate> &info) {
+        HTMLTemplate *compiled = info.GetParameter();
+        compiled->object.Reset();
+        delete compiled;
+    }, WeakCallbackType::kParameter);
+
+    args.GetReturnValue().Set(templateObject);
+}
+
 static void Akeno_HTMLParser_needsUpdate(const FunctionCallbackInfo<Value> &args) {
     Isolate *isolate = args.GetIsolate();
     HTMLParserWrapper *parser = getParserWrapper(args);
@@ -590,7 +1136,7 @@ static void Akeno_HTMLParser_needsUpdate(const FunctionCallbackInfo<Value> &args
 
     String::Utf8Value path(isolate, args[0]);
     std::string filePath(*path ? *path : "", path.length());
-    bool needsUpdate = parser->ctx.needsUpdate(filePath);
+    bool needsUpdate = parser->watchedFiles.contains(filePath) ? parser->changedFiles.contains(filePath) : parser->ctx.needsUpdate(filePath);
     args.GetReturnValue().Set(Boolean::New(isolate, needsUpdate));
 }
 
@@ -602,11 +1148,13 @@ void Akeno_HTMLParser_constructor(const FunctionCallbackInfo<Value> &args) {
     parserTemplate->InstanceTemplate()->SetInternalFieldCount(1);
 
     parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromString", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromString));
-    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromFile));
+    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromFile, args.Data()));
     parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromMarkdownString", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromMarkdownString));
-    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromMarkdownFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromMarkdownFile));
+    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "fromMarkdownFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_fromMarkdownFile, args.Data()));
     parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "createContext", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_createContext));
-    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "needsUpdate", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_needsUpdate));
+    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "renderTo", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_renderTo, args.Data()));
+    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "compile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_compile, args.Data()));
+    parserTemplate->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "needsUpdate", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, Akeno_HTMLParser_needsUpdate, args.Data()));
 
     Local<Object> parserObject = parserTemplate->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()
         ->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
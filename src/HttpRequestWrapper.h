@@ -19,8 +19,45 @@
 #include "Utilities.h"
 
 #include <v8.h>
+#include <vector>
+#include <utility>
 using namespace v8;
 
+/* Marks a request object (internal field 1) as received over SSL */
+static int kSecureRequestTag;
+
+/* Helper for percent-decoding the request path */
+std::string decodeURIComponent(std::string_view url) {
+    std::string decoded;
+    decoded.reserve(url.length());
+    for (size_t i = 0; i < url.length(); ++i) {
+        if (url[i] == '%' && i + 2 < url.length()) {
+            char key[3] = {url[i + 1], url[i + 2], '\0'};
+            char *end;
+            unsigned long value = strtoul(key, &end, 16);
+            if (end == key + 2) {
+                decoded += (char)value;
+                i += 2;
+            } else {
+                decoded += url[i];
+            }
+        } else {
+            decoded += url[i];
+        }
+    }
+    return decoded;
+}
+
+inline v8::Local<v8::String>
+oneByte(v8::Isolate* isolate, std::string_view sv) {
+    return v8::String::NewFromOneByte(
+        isolate,
+        reinterpret_cast<const uint8_t*>(sv.data()),
+        v8::NewStringType::kNormal,
+        static_cast<int>(sv.size())
+    ).ToLocalChecked();
+}
+
 /* This one is the same for SSL and non-SSL */
 struct HttpRequestWrapper {
 
@@ -58,6 +95,40 @@ struct HttpRequestWrapper {
         }
     }
 
+    /* Takes nothing, returns flat array of name, value, name, value... Or takes array of names, returns array of values */
+    template <int QUIC>
+    static void req_getHeaders(const FunctionCallbackInfo<Value> &args) {
+        Isolate *isolate = args.GetIsolate();
+        auto *req = getHttpRequest<QUIC>(args);
+        if (req) {
+            std::vector<Local<Value>> elements;
+
+            if (args.Length() && args[0]->IsArray()) {
+                Local<Array> names = Local<Array>::Cast(args[0]);
+                uint32_t length = names->Length();
+                elements.reserve(length);
+
+                for (uint32_t i = 0; i < length; i++) {
+                    NativeString name(isolate, names->Get(isolate->GetCurrentContext(), i).ToLocalChecked());
+                    if (name.isInvalid(args)) {
+                        return;
+                    }
+
+                    std::string_view header = req->getHeader(name.getString());
+                    elements.push_back(String::NewFromOneByte(isolate, (const uint8_t *) header.data(), NewStringType::kNormal, header.length()).ToLocalChecked());
+                }
+            } else {
+                for (auto p : *req) {
+                    /* Header names repeat across requests, internalizing them makes later property lookups cheap */
+                    elements.push_back(String::NewFromOneByte(isolate, (const uint8_t *) p.first.data(), NewStringType::kInternalized, p.first.length()).ToLocalChecked());
+                    elements.push_back(String::NewFromOneByte(isolate, (const uint8_t *) p.second.data(), NewStringType::kNormal, p.second.length()).ToLocalChecked());
+                }
+            }
+
+            args.GetReturnValue().Set(Array::New(isolate, elements.data(), elements.size()));
+        }
+    }
+
     /* Takes int or string, returns string (must be in bounds) */
     template <int QUIC>
     static void req_getParameter(const FunctionCallbackInfo<Value> &args) {
@@ -177,13 +248,107 @@ struct HttpRequestWrapper {
         }
     }
 
-    /* Returns a clonable object wrapping an HttpRequest */
+    /* Lazy request properties. V8 replaces these with plain data properties on first read,
+     * so each one is computed at most once per request and unread ones cost nothing (see init for pooled requests) */
+    enum LazyProperty : int32_t {
+        kMethod, kOrigin, kSecure, kHost, kDomain, kPath, kContentType, kContentLength
+    };
+
+    static void req_getLazyProperty(Local<Name> property, const PropertyCallbackInfo<Value> &info) {
+        Isolate *isolate = info.GetIsolate();
+        Local<Object> self = info.This();
+
+        auto *req = (uWS::HttpRequest *) self->GetAlignedPointerFromInternalField(0);
+        if (!req) {
+            /* Pooled requests of async handlers, see materialize */
+            if (self->InternalFieldCount() > 2) {
+                Local<Data> snapshot = self->GetInternalField(2);
+                if (snapshot->IsValue() && snapshot.As<Value>()->IsObject()) {
+                    Local<Value> value;
+                    if (snapshot.As<Value>().As<Object>()->Get(isolate->GetCurrentContext(), property).ToLocal(&value)) {
+                        info.GetReturnValue().Set(value);
+                    }
+                    return;
+                }
+            }
+            isolate->ThrowException(v8::Exception::Error(String::NewFromUtf8(isolate, "uWS.HttpRequest must not be accessed after await or route handler return. See documentation for uWS.HttpRequest and consult the user manual.", NewStringType::kNormal).ToLocalChecked()));
+            return;
+        }
+
+        switch ((LazyProperty) info.Data().As<Int32>()->Value()) {
+        case kMethod:
+            info.GetReturnValue().Set(oneByte(isolate, req->getCaseSensitiveMethod()));
+            break;
+        case kOrigin:
+            info.GetReturnValue().Set(oneByte(isolate, req->getHeader("origin")));
+            break;
+        case kSecure:
+            info.GetReturnValue().Set(self->GetAlignedPointerFromInternalField(1) == (void *) &kSecureRequestTag);
+            break;
+        case kHost:
+        case kDomain: {
+            std::string_view host = req->getHeader("host");
+            if (info.Data().As<Int32>()->Value() == kDomain) {
+                host = host.substr(0, host.find(':'));
+            }
+            info.GetReturnValue().Set(oneByte(isolate, host));
+            break;
+        }
+        case kPath: {
+            std::string_view url = req->getUrl();
+            if (url.find('%') != std::string_view::npos) {
+                info.GetReturnValue().Set(oneByte(isolate, decodeURIComponent(url)));
+            } else {
+                info.GetReturnValue().Set(oneByte(isolate, url));
+            }
+            break;
+        }
+        case kContentType:
+        case kContentLength: {
+            /* Only present for methods that carry a body */
+            std::string_view method = req->getCaseSensitiveMethod();
+            if (method != "POST" && method != "PUT" && method != "PATCH" && method != "DELETE") {
+                return;
+            }
+            info.GetReturnValue().Set(oneByte(isolate, req->getHeader(info.Data().As<Int32>()->Value() == kContentType ? "content-type" : "content-length")));
+            break;
+        }
+        }
+    }
+
+    static constexpr std::pair<const char *, LazyProperty> lazyProperties[] = {
+        {"method", kMethod}, {"origin", kOrigin}, {"secure", kSecure}, {"host", kHost},
+        {"domain", kDomain}, {"path", kPath}, {"contentType", kContentType}, {"contentLength", kContentLength}
+    };
+
+    /* Computes every lazy property that was not read yet, so the request stays readable after an await.
+     * Called for handlers returning a promise, right before the request is invalidated. Pooled requests
+     * compute their properties on every read, they keep a snapshot (internal field 2) to read from instead */
+    static void materialize(Isolate *isolate, Local<Object> reqObject, bool pooled = false) {
+        Local<Context> context = isolate->GetCurrentContext();
+        Local<Object> snapshot = pooled ? Object::New(isolate) : Local<Object>();
+        for (auto [name, id] : lazyProperties) {
+            Local<String> key = String::NewFromUtf8(isolate, name, NewStringType::kInternalized).ToLocalChecked();
+            /* Reading a lazy data property replaces it with its value */
+            Local<Value> value;
+            if (reqObject->Get(context, key).ToLocal(&value) && pooled) {
+                snapshot->Set(context, key, value).IsNothing();
+            }
+        }
+        if (pooled) {
+            reqObject->SetInternalField(2, snapshot);
+        }
+    }
+
+    /* Returns a clonable object wrapping an HttpRequest. Pooled objects are reused across requests,
+     * so their properties are read-only and computed on every read instead of memoized (or read from
+     * the snapshot taken by materialize once invalidated) */
     template <int QUIC>
-    static Local<Object> init(Isolate *isolate) {
+    static Local<Object> init(Isolate *isolate, bool pooled = false) {
         /* We do clone every request object, we could share them, they are illegal to use outside the function anyways */
         Local<FunctionTemplate> reqTemplateLocal = FunctionTemplate::New(isolate);
         reqTemplateLocal->SetClassName(String::NewFromUtf8(isolate, QUIC ? "uWS.Http3Request" : "uWS.HttpRequest", NewStringType::kNormal).ToLocalChecked());
-        reqTemplateLocal->InstanceTemplate()->SetInternalFieldCount(1);
+        reqTemplateLocal->InstanceTemplate()->SetInternalFieldCount(QUIC ? 1 : (pooled ? 3 : 2));
 
         /* Register our functions */
         reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getHeader", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_getHeader<QUIC>));
@@ -195,13 +360,32 @@ struct HttpRequestWrapper {
             reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getCaseSensitiveMethod", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_getCaseSensitiveMethod<QUIC>));
             reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getQuery", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_getQuery<QUIC>));
             reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "forEach", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_forEach<QUIC>));
+            reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getHeaders", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_getHeaders<QUIC>));
             reqTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "setYield", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, req_setYield<QUIC>));
+
+            /* Lazy properties live on the instance so that clones carry them */
+            for (auto [name, id] : lazyProperties) {
+                Local<String> key = String::NewFromUtf8(isolate, name, NewStringType::kInternalized).ToLocalChecked();
+                if (pooled) {
+                    reqTemplateLocal->InstanceTemplate()->SetNativeDataProperty(key, req_getLazyProperty, nullptr, Int32::New(isolate, id), ReadOnly);
+                } else {
+                    reqTemplateLocal->InstanceTemplate()->SetLazyDataProperty(key, req_getLazyProperty, Int32::New(isolate, id));
+                }
+            }
         }
 
 
         /* Create the template */
         Local<Object> reqObjectLocal = reqTemplateLocal->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
 
+        if constexpr (!QUIC) {
+            reqObjectLocal->SetAlignedPointerInInternalField(0, nullptr);
+            reqObjectLocal->SetAlignedPointerInInternalField(1, nullptr);
+            if (pooled) {
+                reqObjectLocal->SetInternalField(2, Undefined(isolate));
+            }
+        }
+
         return reqObjectLocal;
     }
 };
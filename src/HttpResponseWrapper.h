@@ -22,9 +22,15 @@
 #include "Utilities.h"
 #include "akeno/Router.h"
 #include "akeno/Misc.h"
+#include "CachedHttpResponse.h"
+#include "HttpValidators.h"
+#include "ByteRanges.h"
+#include "FileStream.h"
+#include "AsyncFile.h"
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <v8.h>
 #include <node_buffer.h>
@@ -33,6 +39,9 @@ using namespace v8;
 
 thread_local int insideCorkCallback = 0;
 
+/* Marks a response object (internal field 1) as not safe to reuse, see pinResObject */
+static int kPinnedResponseTag;
+
 /* PROTOCOL is 0 = TCP, 1 = TLS, 2 = QUIC, 3 = CACHE */
 
 struct HttpResponseWrapper {
@@ -79,8 +88,7 @@ struct HttpResponseWrapper {
         if constexpr (PROTOCOL == 2) {
             return (uWS::Http3Response *) res;
         } else if constexpr (PROTOCOL == 3) {
-            //return (uWS::CachingHttpResponse *) res; // is correct
-            return (uWS::HttpResponse<PROTOCOL != 0> *) res; // not correct
+            return (CachedHttpResponse *) res;
         } else {
             return (uWS::HttpResponse<PROTOCOL != 0> *) res;
         }
@@ -91,6 +99,30 @@ struct HttpResponseWrapper {
         args.This()->SetAlignedPointerInInternalField(0, nullptr);
     }
 
+    /* Marks a response object as referenced from native callbacks, so it never goes back to the wrapper pool */
+    static inline void pinResObject(const FunctionCallbackInfo<Value> &args) {
+        args.This()->SetAlignedPointerInInternalField(1, (void *) &kPinnedResponseTag);
+    }
+
+    /* The handler given to res.onAborted (internal field 2), as a native one. Native code that takes over the abort
+     * handler of a response (streamFile, renderTo) calls it once it cleaned up, so the user's handler still runs */
+    static uWS::MoveOnlyFunction<void()> takeAbortHandler(Isolate *isolate, Local<Object> resObject) {
+        if (resObject->InternalFieldCount() < 3) {
+            return {};
+        }
+        Local<Data> handler = resObject->GetInternalField(2);
+        if (!handler->IsValue() || !handler.As<Value>()->IsFunction()) {
+            return {};
+        }
+        resObject->SetInternalField(2, Undefined(isolate));
+
+        UniquePersistent<Function> p(isolate, handler.As<Value>().As<Function>());
+        return [p = std::move(p), isolate]() {
+            HandleScope hs(isolate);
+            CallJS(isolate, Local<Function>::New(isolate, p), 0, nullptr);
+        };
+    }
+
     /* Takes nothing, returns this */
     template <int SSL>
     static void res_pause(const FunctionCallbackInfo<Value> &args) {
@@ -122,24 +154,32 @@ struct HttpResponseWrapper {
         }
     }
 
-    /* Takes function of data and isLast. Expects nothing from callback, returns this */
+    /* Takes function of data and isLast, and optionally reuseBuffers. Expects nothing from callback, returns this */
     template <int SSL>
     static void res_onData(const FunctionCallbackInfo<Value> &args) {
         Isolate *isolate = args.GetIsolate();
         auto *res = getHttpResponse<SSL>(args);
         if (res) {
+            pinResObject(args);
+
+            /* With reuseBuffers, chunks are Uint8Array views into the shared receive arena */
+            ReceiveArena *receiveArena = nullptr;
+            if (args.Length() > 1 && args[1]->BooleanValue(isolate)) {
+                receiveArena = &((PerContextData *) Local<External>::Cast(args.Data())->Value())->receiveArena;
+            }
+
             /* This thing perfectly fits in with unique_function, and will Reset on destructor */
             UniquePersistent<Function> p(isolate, Local<Function>::Cast(args[0]));
 
-            res->onData([p = std::move(p), isolate](std::string_view data, bool last) {
+            res->onData([p = std::move(p), isolate, receiveArena](std::string_view data, bool last) {
                 HandleScope hs(isolate);
 
-                Local<ArrayBuffer> dataArrayBuffer = ArrayBuffer_New(isolate, (void *) data.data(), data.length());
+                ReceivedData received(isolate, receiveArena, data);
 
-                Local<Value> argv[] = {dataArrayBuffer, Boolean::New(isolate, last)};
+                Local<Value> argv[] = {received.value, Boolean::New(isolate, last)};
                 CallJS(isolate, Local<Function>::New(isolate, p), 2, argv);
 
-                dataArrayBuffer->Detach();
+                received.detach();
             });
 
             args.GetReturnValue().Set(args.This());
@@ -152,12 +192,17 @@ struct HttpResponseWrapper {
         Isolate *isolate = args.GetIsolate();
         auto *res = getHttpResponse<SSL>(args);
         if (res) {
+            pinResObject(args);
+
             /* This thing perfectly fits in with unique_function, and will Reset on destructor */
             UniquePersistent<Function> p(isolate, Local<Function>::Cast(args[0]));
 
             /* This is how we capture res (C++ this in invocation of this function) */
             UniquePersistent<Object> resObject(isolate, args.This());
 
+            /* Kept for native streams that replace this handler, see takeAbortHandler. Pinned objects are never pooled */
+            args.This()->SetInternalField(2, args[0]);
+
             res->onAborted([p = std::move(p), resObject = std::move(resObject), isolate]() {
                 HandleScope hs(isolate);
 
@@ -247,6 +292,8 @@ struct HttpResponseWrapper {
         Isolate *isolate = args.GetIsolate();
         auto *res = getHttpResponse<SSL>(args);
         if (res) {
+            pinResObject(args);
+
             /* This thing perfectly fits in with unique_function, and will Reset on destructor */
             UniquePersistent<Function> p(isolate, Local<Function>::Cast(args[0]));
 
@@ -494,6 +541,59 @@ struct HttpResponseWrapper {
         }
     }
 
+    /* What streamFile options ask for, read before the file is open */
+    struct StreamFileOptions {
+        bool conditional = false;
+        std::string range;
+        std::string ifRange;
+        std::string contentType;
+    };
+
+    /* Answers with an open file, takes ownership of fd. aborted is the user's abort handler, see takeAbortHandler */
+    template <int PROTOCOL>
+    static void streamOpenFile(uWS::HttpResponse<PROTOCOL == 1> *res, PerContextData *perContextData, int fd, bool regular, uint64_t size, int64_t mtime, const StreamFileOptions &options, uWS::MoveOnlyFunction<void()> &&aborted) {
+        if (!regular) {
+            if (aborted) {
+                res->onAborted(std::move(aborted));
+            }
+            res->streamFile(fd); // closes by default
+            return;
+        }
+
+        /* With options (range, ifRange, contentType from the request) range requests are supported */
+        ByteRanges ranges({}, size);
+        if (options.conditional) {
+            std::string etag = makeFileETag(size, mtime);
+            ranges = ByteRanges(ifRangeMatches(options.ifRange, etag, mtime) ? options.range : std::string(), size, options.contentType);
+
+            if (ranges.result == ByteRanges::UNSATISFIABLE) {
+                ::close(fd);
+                ranges.endUnsatisfiable(res);
+                return;
+            }
+
+            if (ranges.result == ByteRanges::PARTIAL) {
+                res->writeStatus("206 Partial Content");
+            }
+            res->writeHeader("Accept-Ranges", "bytes")
+                ->writeHeader("ETag", etag)
+                ->writeHeader("Last-Modified", formatHttpDate(mtime));
+        }
+
+        /* Plain TCP streams with sendfile, TLS too where the protocol has ktls and the kernel takes the connection over */
+        bool ktls = PROTOCOL == 1 && perContextData->ktlsContexts.contains(us_socket_context(1, (us_socket_t *) res));
+        bool kernelWrites = FileStream<PROTOCOL == 1>::canSendfile(res, ktls);
+        if (ranges.result == ByteRanges::PARTIAL || kernelWrites) {
+            FileStream<PROTOCOL == 1>::start(res, node::GetCurrentEventLoop(perContextData->isolate), fd, std::move(ranges), kernelWrites, std::move(aborted));
+            return;
+        }
+
+        if (aborted) {
+            res->onAborted(std::move(aborted));
+        }
+        res->streamFile(fd); // closes by default
+    }
+
     template <int PROTOCOL>
     static void res_streamFile(const FunctionCallbackInfo<Value> &args) {
         Isolate *isolate = args.GetIsolate();
@@ -503,29 +603,79 @@ struct HttpResponseWrapper {
                 return;
             }
 
-            int fd = -1;
+            auto *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+
+            StreamFileOptions options;
+            if (args.Length() > 1 && args[1]->IsObject()) {
+                Local<Object> object = Local<Object>::Cast(args[1]);
+                auto getString = [&](const char *name) {
+                    Local<Value> value;
+                    if (!object->Get(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, name, NewStringType::kNormal).ToLocalChecked()).ToLocal(&value) || !value->IsString()) {
+                        return std::string();
+                    }
+                    NativeString string(isolate, value);
+                    return std::string(string.getString());
+                };
+
+                options.conditional = true;
+                options.range = getString("range");
+                options.ifRange = getString("ifRange");
+                options.contentType = getString("contentType");
+            }
 
             if (args[0]->IsString()) {
                 NativeString path(isolate, args[0]);
                 if (path.isInvalid(args)) {
                     return;
                 }
-                fd = open(path.getString().data(), O_RDONLY);
-                if (fd < 0) {
-                    isolate->ThrowException(v8::Exception::Error(
-                        String::NewFromUtf8(isolate, "Failed to open file", NewStringType::kNormal).ToLocalChecked()
-                    ));
-                    return;
-                }
-            } else {
-                fd = args[0]->Int32Value(isolate->GetCurrentContext()).ToChecked();
+
+                // streamFile ends the response
+                invalidateResObject(args);
+
+                /* The file is opened off the loop, the response is answered once it is (or with 404 if it can't be).
+                 * An abort before that still reaches the user's handler */
+                struct Opening {
+                    bool aborted = false;
+                    uWS::MoveOnlyFunction<void()> abortHandler;
+                };
+                auto opening = std::make_shared<Opening>();
+                opening->abortHandler = takeAbortHandler(isolate, args.This());
+                res->onAborted([opening]() {
+                    opening->aborted = true;
+                    if (opening->abortHandler) {
+                        opening->abortHandler();
+                    }
+                });
+
+                AsyncFile::open(node::GetCurrentEventLoop(isolate), std::string(path.getString()), [res, perContextData, opening, options = std::move(options)](int fd, const uv_stat_t *st) {
+                    if (opening->aborted) {
+                        if (fd >= 0) {
+                            ::close(fd);
+                        }
+                        return;
+                    }
+
+                    res->cork([&]() {
+                        if (fd < 0) {
+                            res->writeStatus("404 Not Found")->end();
+                            return;
+                        }
+                        streamOpenFile<PROTOCOL>(res, perContextData, fd, S_ISREG(st->st_mode), (uint64_t) st->st_size, (int64_t) st->st_mtim.tv_sec, options, std::move(opening->abortHandler));
+                    });
+                });
+                return;
             }
 
+            int fd = args[0]->Int32Value(isolate->GetCurrentContext()).ToChecked();
+
             // streamFile ends the response
             invalidateResObject(args);
 
             assumeCorked();
-            res->streamFile(fd); // closes by default
+
+            struct stat st;
+            bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+            streamOpenFile<PROTOCOL>(res, perContextData, fd, regular, regular ? (uint64_t) st.st_size : 0, regular ? (int64_t) st.st_mtime : 0, options, takeAbortHandler(isolate, args.This()));
         }
     }
 
@@ -550,6 +700,196 @@ struct HttpResponseWrapper {
         }
     }
 
+    /* Collects headers given as flat array [key, value, key, value...] or as object into key, value pairs and checks
+     * them without writing anything, so a bad one can't leave a half written response. Numbers are valid values.
+     * Returns false if it threw */
+    static bool collectHeaders(const FunctionCallbackInfo<Value> &args, Local<Value> headers, std::vector<Local<Value>> &pairs) {
+        Isolate *isolate = args.GetIsolate();
+        Local<Context> context = isolate->GetCurrentContext();
+
+        if (headers->IsArray()) {
+            Local<Array> array = Local<Array>::Cast(headers);
+            uint32_t length = array->Length() & ~1u;
+            pairs.reserve(length);
+            for (uint32_t i = 0; i < length; i++) {
+                Local<Value> value;
+                if (!array->Get(context, i).ToLocal(&value)) {
+                    return false;
+                }
+                pairs.push_back(value);
+            }
+        } else if (headers->IsObject()) {
+            Local<Object> object = Local<Object>::Cast(headers);
+            Local<Array> keys;
+            if (!object->GetOwnPropertyNames(context).ToLocal(&keys)) {
+                return false;
+            }
+            pairs.reserve(keys->Length() * 2);
+            for (uint32_t i = 0; i < keys->Length(); i++) {
+                Local<Value> key, value;
+                if (!keys->Get(context, i).ToLocal(&key) || !object->Get(context, key).ToLocal(&value)) {
+                    return false;
+                }
+                pairs.push_back(key);
+                pairs.push_back(value);
+            }
+        }
+
+        /* Same as NativeString takes */
+        for (size_t i = 0; i < pairs.size(); i++) {
+            Local<Value> value = pairs[i];
+            if (!value->IsUndefined() && !value->IsString() && !value->IsTypedArray() && !value->IsArrayBuffer() &&
+                !value->IsSharedArrayBuffer() && !(i % 2 && value->IsNumber())) {
+                args.GetReturnValue().Set(isolate->ThrowException(v8::Exception::TypeError(String::NewFromUtf8(isolate, "Header names and values can only be passed by String, ArrayBuffer or TypedArray, values also by Number.", NewStringType::kNormal).ToLocalChecked())));
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /* Writes pairs checked by collectHeaders */
+    template <class Response>
+    static void writeHeaderPairs(Isolate *isolate, Response *res, const std::vector<Local<Value>> &pairs) {
+        for (size_t i = 0; i < pairs.size(); i += 2) {
+            NativeString header(isolate, pairs[i]);
+            /* Integers are written as such, any other number (negative, fractional, NaN) as its string form */
+            if (pairs[i + 1]->IsNumber()) {
+                double number = pairs[i + 1].As<Number>()->Value();
+                if (number >= 0 && number <= 9007199254740991.0 && number == (double) (uint64_t) number) {
+                    res->writeHeader(header.getString(), (uint64_t) number);
+                    continue;
+                }
+                NativeString value(isolate, pairs[i + 1]->ToString(isolate->GetCurrentContext()).ToLocalChecked());
+                res->writeHeader(header.getString(), value.getString());
+                continue;
+            }
+            NativeString value(isolate, pairs[i + 1]);
+            res->writeHeader(header.getString(), value.getString());
+        }
+    }
+
+    /* Takes flat array [key, value, ...] or object of headers. Returns this */
+    template <int PROTOCOL>
+    static void res_writeHeaders(const FunctionCallbackInfo<Value> &args) {
+        auto *res = getHttpResponse<PROTOCOL>(args);
+        if (res) {
+            std::vector<Local<Value>> headers;
+            if (!collectHeaders(args, args[0], headers)) {
+                return;
+            }
+
+            assumeCorked();
+            writeHeaderPairs(args.GetIsolate(), res, headers);
+
+            args.GetReturnValue().Set(args.This());
+        }
+    }
+
+    /* Takes status, headers (see writeHeaders) and body, any of them may be undefined. Ends the response, returns this */
+    template <int PROTOCOL>
+    static void res_respond(const FunctionCallbackInfo<Value> &args) {
+        Isolate *isolate = args.GetIsolate();
+        auto *res = getHttpResponse<PROTOCOL>(args);
+        if (res) {
+            /* Validate everything first, we can't take back a written status. Headers go first as their getters may run JS */
+            std::vector<Local<Value>> headers;
+            if (!collectHeaders(args, args[1], headers)) {
+                return;
+            }
+            NativeString status(isolate, args[0]);
+            if (status.isInvalid(args)) {
+                return;
+            }
+            NativeString body(isolate, args[2]);
+            if (body.isInvalid(args)) {
+                return;
+            }
+
+            assumeCorked();
+            if (status.getString().length()) {
+                res->writeStatus(status.getString());
+            }
+            writeHeaderPairs(isolate, res, headers);
+
+            invalidateResObject(args);
+            res->end(body.getString());
+
+            args.GetReturnValue().Set(args.This());
+        }
+    }
+
+#ifdef AKENO_FAST_API
+    /* Fast call variant of getHttpResponse. A fast call can neither throw nor run JS, so a detached response goes to the slow path,
+     * and so does any write outside of a cork: uncorked, uWS may close the socket right away and its close handler calls into JS.
+     * Writes from ticks and microtasks drained at the end of the iteration are only corked by uWS itself, the same applies */
+    template <int PROTOCOL>
+    static inline uWS::HttpResponse<PROTOCOL != 0> *getHttpResponseFast(Local<Object> receiver, FastApiCallbackOptions &options) {
+        auto *res = (uWS::HttpResponse<PROTOCOL != 0> *) receiver->GetAlignedPointerFromInternalField(0);
+        if (!res || !insideCorkCallback || (directCallState && directCallState->draining)) {
+            fallBack(options);
+            return nullptr;
+        }
+        return res;
+    }
+
+    /* Fast call end(data) */
+    template <int PROTOCOL>
+    static void res_end_fast(Local<Object> receiver, const FastOneByteString &data, FastApiCallbackOptions &options) {
+        res_endClose_fast<PROTOCOL>(receiver, data, false, options);
+    }
+
+    /* Fast call end(data, closeConnection). Closing the connection is left to the slow path, it runs the close handler */
+    template <int PROTOCOL>
+    static void res_endClose_fast(Local<Object> receiver, const FastOneByteString &data, bool closeConnection, FastApiCallbackOptions &options) {
+        auto *res = getHttpResponseFast<PROTOCOL>(receiver, options);
+        if (!res || closeConnection || !isAsciiOneByte(data)) {
+            fallBack(options);
+            return;
+        }
+
+        receiver->SetAlignedPointerInInternalField(0, nullptr);
+
+        res->end({data.data, data.length});
+    }
+
+    /* Fast call write(data) */
+    template <int PROTOCOL>
+    static bool res_write_fast(Local<Object> receiver, const FastOneByteString &data, FastApiCallbackOptions &options) {
+        auto *res = getHttpResponseFast<PROTOCOL>(receiver, options);
+        if (!res || !isAsciiOneByte(data)) {
+            fallBack(options);
+            return false;
+        }
+
+        return res->write({data.data, data.length});
+    }
+
+    /* Fast call writeStatus(status) */
+    template <int PROTOCOL>
+    static void res_writeStatus_fast(Local<Object> receiver, const FastOneByteString &status, FastApiCallbackOptions &options) {
+        auto *res = getHttpResponseFast<PROTOCOL>(receiver, options);
+        if (!res || !isAsciiOneByte(status)) {
+            fallBack(options);
+            return;
+        }
+
+        res->writeStatus({status.data, status.length});
+    }
+
+    /* Fast call writeHeader(key, value) */
+    template <int PROTOCOL>
+    static void res_writeHeader_fast(Local<Object> receiver, const FastOneByteString &key, const FastOneByteString &value, FastApiCallbackOptions &options) {
+        auto *res = getHttpResponseFast<PROTOCOL>(receiver, options);
+        if (!res || !isAsciiOneByte(key) || !isAsciiOneByte(value)) {
+            fallBack(options);
+            return;
+        }
+
+        res->writeHeader({key.data, key.length}, {value.data, value.length});
+    }
+#endif
+
     /* Takes function, returns this */
     template <int SSL>
     static void res_cork(const FunctionCallbackInfo<Value> &args) {
@@ -615,7 +955,7 @@ struct HttpResponseWrapper {
 
     /* 0 = TCP, 1 = TLS, 2 = QUIC, 3 = CACHE */
     template <int SSL>
-    static Local<Object> init(Isolate *isolate) {
+    static Local<Object> init(Isolate *isolate, Local<External> externalPerContextData) {
         Local<FunctionTemplate> resTemplateLocal = FunctionTemplate::New(isolate);
         if (SSL == 1) {
             resTemplateLocal->SetClassName(String::NewFromUtf8(isolate, "uWS.SSLHttpResponse", NewStringType::kNormal).ToLocalChecked());
@@ -626,25 +966,54 @@ struct HttpResponseWrapper {
         } else if (SSL == 3) {
             resTemplateLocal->SetClassName(String::NewFromUtf8(isolate, "uWS.CachedHttpResponse", NewStringType::kNormal).ToLocalChecked());
         }
-        resTemplateLocal->InstanceTemplate()->SetInternalFieldCount(1);
+        resTemplateLocal->InstanceTemplate()->SetInternalFieldCount(3);
+
+        /* The hot methods get fast call overloads on TCP and TLS, with the regular callbacks as slow path */
+        Local<FunctionTemplate> endTemplate = FunctionTemplate::New(isolate, res_end<SSL>);
+        Local<FunctionTemplate> writeTemplate = FunctionTemplate::New(isolate, res_write<SSL>);
+        Local<FunctionTemplate> writeStatusTemplate = FunctionTemplate::New(isolate, res_writeStatus<SSL>);
+        Local<FunctionTemplate> writeHeaderTemplate = FunctionTemplate::New(isolate, res_writeHeader<SSL>);
+#ifdef AKENO_FAST_API
+        if constexpr (SSL == 0 || SSL == 1) {
+            static const CFunction endOverloads[] = {CFunction::Make(res_end_fast<SSL>), CFunction::Make(res_endClose_fast<SSL>)};
+            static const CFunction writeOverloads[] = {CFunction::Make(res_write_fast<SSL>)};
+            static const CFunction writeStatusOverloads[] = {CFunction::Make(res_writeStatus_fast<SSL>)};
+            static const CFunction writeHeaderOverloads[] = {CFunction::Make(res_writeHeader_fast<SSL>)};
+
+            endTemplate = FunctionTemplate_NewFast(isolate, res_end<SSL>, endOverloads);
+            writeTemplate = FunctionTemplate_NewFast(isolate, res_write<SSL>, writeOverloads);
+            writeStatusTemplate = FunctionTemplate_NewFast(isolate, res_writeStatus<SSL>, writeStatusOverloads);
+            writeHeaderTemplate = FunctionTemplate_NewFast(isolate, res_writeHeader<SSL>, writeHeaderOverloads);
+        }
+#endif
 
         /* Register our functions */
-        resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "end", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_end<SSL>));
+        resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "end", NewStringType::kNormal).ToLocalChecked(), endTemplate);
         
-        /* Cache has almost nothing wrapped yet */
-        if constexpr (SSL != 3) {
+        /* Cache only wraps what can be recorded, a route with { cache } hands these out on misses */
+        if constexpr (SSL == 3) {
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeStatus", NewStringType::kNormal).ToLocalChecked(), writeStatusTemplate);
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeHeader", NewStringType::kNormal).ToLocalChecked(), writeHeaderTemplate);
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeHeaders", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_writeHeaders<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "respond", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_respond<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "write", NewStringType::kNormal).ToLocalChecked(), writeTemplate);
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onAborted", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_onAborted<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "cork", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_cork<SSL>));
+        } else {
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "setDefaultErrorPage", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_setDefaultErrorPage<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "sendErrorPage", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_sendErrorPage<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "sendJSONError", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_sendJSONError<SSL>));
-            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeStatus", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_writeStatus<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeStatus", NewStringType::kNormal).ToLocalChecked(), writeStatusTemplate);
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "endWithoutBody", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_endWithoutBody<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "tryEnd", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_tryEnd<SSL>));
-            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "write", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_write<SSL>));
-            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeHeader", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_writeHeader<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "write", NewStringType::kNormal).ToLocalChecked(), writeTemplate);
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeHeader", NewStringType::kNormal).ToLocalChecked(), writeHeaderTemplate);
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "writeHeaders", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_writeHeaders<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "respond", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_respond<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "close", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_close<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onWritable", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_onWritable<SSL>));
             resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onAborted", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_onAborted<SSL>));
-            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onData", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_onData<SSL>));
+            resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "onData", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_onData<SSL>, externalPerContextData));
             
             /* QUIC has a lot of functions unimplemented */
             if constexpr (SSL != 2) {
@@ -659,7 +1028,7 @@ struct HttpResponseWrapper {
                 resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getProxiedRemoteAddressAsText", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_getProxiedRemoteAddressAsText<SSL>));
                 resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "pause", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_pause<SSL>));
                 resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "resume", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_resume<SSL>));
-                resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "streamFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_streamFile<SSL>));
+                resTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "streamFile", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, res_streamFile<SSL>, externalPerContextData));
             }
         }
 
@@ -669,6 +1038,19 @@ struct HttpResponseWrapper {
         
         /* Create our template */
         Local<Object> resObjectLocal = resTemplateLocal->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()->NewInstance(isolate->GetCurrentContext()).ToLocalChecked();
+        resObjectLocal->SetAlignedPointerInInternalField(0, nullptr);
+        resObjectLocal->SetAlignedPointerInInternalField(1, nullptr);
+        resObjectLocal->SetInternalField(2, Undefined(isolate));
+
+#ifdef AKENO_FAST_API
+        /* Fast calls return undefined, keep end, writeStatus and writeHeader chainable */
+        if constexpr (SSL == 0 || SSL == 1) {
+            Local<Object> prototype = Local<Object>::Cast(resObjectLocal->GetPrototype());
+            shimReturnThis(isolate, prototype, "end");
+            shimReturnThis(isolate, prototype, "writeStatus");
+            shimReturnThis(isolate, prototype, "writeHeader");
+        }
+#endif
 
         // if constexpr (SSL != 3) {
         //     setErrorPageBuffers(isolate, resObjectLocal, Akeno::errorPageHead, Akeno::errorPageTail);
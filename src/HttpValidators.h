@@ -0,0 +1,109 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+
+#include "akeno/external/ankerl/unordered_dense.h"
+
+/* ETags and HTTP dates for conditional and range requests (RFC 9110 8.8, 13) */
+
+/* Strong ETag of some content, the length makes a collision of the 64-bit hash even less likely */
+static inline std::string makeETag(std::string_view data) {
+    char etag[48];
+    int length = snprintf(etag, sizeof(etag), "\"%zx-%016llx\"", data.length(), (unsigned long long) ankerl::unordered_dense::hash<std::string_view>{}(data));
+    return std::string(etag, (size_t) length);
+}
+
+/* Strong ETag of a content coded representation of etag's content, every coding needs its own (RFC 9110 8.8.3.3) */
+static inline std::string makeEncodedETag(std::string_view etag, std::string_view encoding) {
+    std::string encoded(etag.substr(0, etag.length() - 1));
+    encoded.append("-").append(encoding).append("\"");
+    return encoded;
+}
+
+/* ETag of a file we don't read, from its size and modification time */
+static inline std::string makeFileETag(uint64_t size, int64_t mtime) {
+    char etag[48];
+    int length = snprintf(etag, sizeof(etag), "\"%llx-%llx\"", (unsigned long long) mtime, (unsigned long long) size);
+    return std::string(etag, (size_t) length);
+}
+
+static constexpr const char *httpDateDays[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+static constexpr std::string_view httpDateMonths = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+/* IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT" */
+static inline std::string formatHttpDate(int64_t seconds) {
+    std::chrono::sys_seconds time{std::chrono::seconds(seconds)};
+    std::chrono::sys_days days = std::chrono::floor<std::chrono::days>(time);
+    std::chrono::year_month_day date{days};
+    std::chrono::hh_mm_ss<std::chrono::seconds> clock{time - days};
+
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%s, %02u %.3s %04d %02d:%02d:%02d GMT",
+        httpDateDays[std::chrono::weekday{days}.c_encoding()], (unsigned) date.day(), httpDateMonths.data() + ((unsigned) date.month() - 1) * 3,
+        (int) date.year(), (int) clock.hours().count(), (int) clock.minutes().count(), (int) clock.seconds().count());
+    return std::string(buffer, (size_t) length);
+}
+
+/* Parses an IMF-fixdate, returns -1 for anything else (obsolete formats are not worth it for revalidation) */
+static inline int64_t parseHttpDate(std::string_view value) {
+    if (value.length() != 29 || value.substr(25) != " GMT") {
+        return -1;
+    }
+
+    auto number = [&](size_t offset, size_t length) {
+        int result = 0;
+        for (size_t i = offset; i < offset + length; i++) {
+            if (value[i] < '0' || value[i] > '9') {
+                return -1;
+            }
+            result = result * 10 + (value[i] - '0');
+        }
+        return result;
+    };
+
+    size_t month = httpDateMonths.find(value.substr(8, 3));
+    int day = number(5, 2), year = number(12, 4), hours = number(17, 2), minutes = number(20, 2), seconds = number(23, 2);
+    if (month == std::string_view::npos || month % 3 || day < 0 || year < 0 || hours < 0 || minutes < 0 || seconds < 0) {
+        return -1;
+    }
+
+    std::chrono::year_month_day date{std::chrono::year{year}, std::chrono::month{(unsigned) month / 3 + 1}, std::chrono::day{(unsigned) day}};
+    if (!date.ok()) {
+        return -1;
+    }
+    return (std::chrono::sys_days{date}.time_since_epoch() + std::chrono::hours{hours} + std::chrono::minutes{minutes} + std::chrono::seconds{seconds}) / std::chrono::seconds(1);
+}
+
+/* If-None-Match list against our ETag, with the weak comparison */
+static inline bool etagListMatches(std::string_view list, std::string_view etag) {
+    while (list.length()) {
+        size_t comma = list.find(',');
+        std::string_view tag = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+
+        while (tag.length() && tag.front() == ' ') tag.remove_prefix(1);
+        while (tag.length() && tag.back() == ' ') tag.remove_suffix(1);
+        if (tag.starts_with("W/")) {
+            tag.remove_prefix(2);
+        }
+        if (tag == "*" || tag == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* If-Range holds either an ETag (strong comparison) or the exact Last-Modified date, anything else means the whole file */
+static inline bool ifRangeMatches(std::string_view ifRange, std::string_view etag, int64_t lastModified) {
+    if (ifRange.empty()) {
+        return true;
+    }
+    if (ifRange.front() == '"') {
+        return ifRange == etag;
+    }
+    return !ifRange.starts_with("W/") && parseHttpDate(ifRange) == lastModified;
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <openssl/ssl.h>
+#include <openssl/hkdf.h>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#endif
+
+/* Linux kernel TLS (the "tls" ULP) for the sending side of a TLS connection. uSockets encrypts records with BoringSSL
+ * through its own BIO, so the kernel can't be told about the keys at the handshake like OpenSSL's SSL_OP_ENABLE_KTLS does.
+ * Instead the current write keys and record sequence are taken from BoringSSL once nothing is buffered, and handed to
+ * the kernel with setsockopt(TLS_TX). From then on whatever is written to the socket, sendfile included, leaves as TLS
+ * records, and nothing may be written through BoringSSL anymore. Receiving stays with BoringSSL */
+struct KernelTLS {
+    /* Whether the kernel knows the negotiated version and cipher, without touching the socket */
+    static bool supported(SSL *ssl) {
+#ifdef __linux__
+        const SSL_CIPHER *cipher = ssl ? SSL_get_current_cipher(ssl) : nullptr;
+        if (!cipher || (SSL_version(ssl) != TLS1_2_VERSION && SSL_version(ssl) != TLS1_3_VERSION)) {
+            return false;
+        }
+        int nid = SSL_CIPHER_get_cipher_nid(cipher);
+        return nid == NID_aes_128_gcm || nid == NID_aes_256_gcm || nid == NID_chacha20_poly1305;
+#else
+        return false;
+#endif
+    }
+
+    /* Hands record encryption of what is sent on fd over to the kernel, continuing where ssl's write state is. Must only
+     * happen with nothing buffered in uSockets or BoringSSL. False if the kernel has no TLS or the cipher isn't supported,
+     * the connection then keeps working through BoringSSL */
+    static bool enableTx(SSL *ssl, int fd) {
+#ifdef __linux__
+        if (!supported(ssl)) {
+            return false;
+        }
+
+        const SSL_CIPHER *cipher = SSL_get_current_cipher(ssl);
+        int nid = SSL_CIPHER_get_cipher_nid(cipher);
+        bool tls13 = SSL_version(ssl) == TLS1_3_VERSION;
+        size_t keyLength = nid == NID_aes_128_gcm ? 16 : 32;
+        /* The per connection nonce, TLS 1.2 GCM has only the 4 byte salt of it (the rest is sent with every record) */
+        size_t ivLength = (nid == NID_chacha20_poly1305 || tls13) ? 12 : 4;
+
+        uint8_t key[32], iv[12];
+        if (!(tls13 ? expandTrafficSecret(ssl, cipher, key, keyLength, iv, ivLength) : serverKeyBlock(ssl, key, keyLength, iv, ivLength))) {
+            return false;
+        }
+
+        uint8_t sequence[8];
+        uint64_t writeSequence = SSL_get_write_sequence(ssl);
+        for (int i = 7; i >= 0; i--) {
+            sequence[i] = (uint8_t) writeSequence;
+            writeSequence >>= 8;
+        }
+
+        union {
+            tls12_crypto_info_aes_gcm_128 aes128;
+            tls12_crypto_info_aes_gcm_256 aes256;
+            tls12_crypto_info_chacha20_poly1305 chacha20;
+        } info;
+        memset(&info, 0, sizeof(info));
+        socklen_t infoLength;
+
+        uint16_t version = tls13 ? TLS_1_3_VERSION : TLS_1_2_VERSION;
+        if (nid == NID_chacha20_poly1305) {
+            info.chacha20.info = {version, TLS_CIPHER_CHACHA20_POLY1305};
+            memcpy(info.chacha20.key, key, 32);
+            memcpy(info.chacha20.iv, iv, 12);
+            memcpy(info.chacha20.rec_seq, sequence, 8);
+            infoLength = sizeof(info.chacha20);
+        } else if (nid == NID_aes_128_gcm) {
+            info.aes128.info = {version, TLS_CIPHER_AES_GCM_128};
+            memcpy(info.aes128.key, key, 16);
+            fillGcmNonce(info.aes128.salt, info.aes128.iv, iv, sequence, tls13);
+            memcpy(info.aes128.rec_seq, sequence, 8);
+            infoLength = sizeof(info.aes128);
+        } else {
+            info.aes256.info = {version, TLS_CIPHER_AES_GCM_256};
+            memcpy(info.aes256.key, key, 32);
+            fillGcmNonce(info.aes256.salt, info.aes256.iv, iv, sequence, tls13);
+            memcpy(info.aes256.rec_seq, sequence, 8);
+            infoLength = sizeof(info.aes256);
+        }
+        OPENSSL_cleanse(key, sizeof(key));
+
+        /* ENOENT without the tls module. A socket with the ULP but no TLS_TX still sends as plain TCP does */
+        bool ok = setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0 && setsockopt(fd, SOL_TLS, TLS_TX, &info, infoLength) == 0;
+        OPENSSL_cleanse(&info, sizeof(info));
+        if (!ok) {
+            return false;
+        }
+
+        /* BoringSSL's sequence is behind now, uSockets closing the connection must not have it send a close_notify */
+        SSL_set_quiet_shutdown(ssl, 1);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /* Ends the TLS stream of a connection handed to the kernel, best effort since the connection closes anyway */
+    static void sendCloseNotify(int fd) {
+#ifdef __linux__
+        /* Alert record (21): warning (1), close_notify (0) */
+        unsigned char alert[2] = {1, 0};
+        char control[CMSG_SPACE(sizeof(unsigned char))] = {};
+
+        iovec iov = {alert, sizeof(alert)};
+        msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        cmsghdr *header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_TLS;
+        header->cmsg_type = TLS_SET_RECORD_TYPE;
+        header->cmsg_len = CMSG_LEN(sizeof(unsigned char));
+        *CMSG_DATA(header) = 21;
+
+        sendmsg(fd, &message, MSG_DONTWAIT | MSG_NOSIGNAL);
+#endif
+    }
+
+private:
+    /* TLS 1.3 write key and iv, HKDF-Expand-Label(secret, "key" / "iv", "", length) from RFC 8446 7.3 */
+    static bool expandTrafficSecret(SSL *ssl, const SSL_CIPHER *cipher, uint8_t *key, size_t keyLength, uint8_t *iv, size_t ivLength) {
+        bssl::Span<const uint8_t> readSecret, writeSecret;
+        const EVP_MD *digest = SSL_CIPHER_get_handshake_digest(cipher);
+        if (!digest || !bssl::SSL_get_traffic_secrets(ssl, &readSecret, &writeSecret)) {
+            return false;
+        }
+
+        auto expandLabel = [&](const char *label, uint8_t *out, size_t length) {
+            uint8_t info[32];
+            size_t labelLength = strlen(label);
+            info[0] = 0;
+            info[1] = (uint8_t) length;
+            info[2] = (uint8_t) (6 + labelLength);
+            memcpy(info + 3, "tls13 ", 6);
+            memcpy(info + 9, label, labelLength);
+            info[9 + labelLength] = 0;
+            return HKDF_expand(out, length, digest, writeSecret.data(), writeSecret.size(), info, 10 + labelLength) == 1;
+        };
+        return expandLabel("key", key, keyLength) && expandLabel("iv", iv, ivLength);
+    }
+
+    /* TLS 1.2 server write key and iv from the key block, which is client and server MAC keys (none with AEADs), then
+     * client and server keys, then client and server ivs (RFC 5246 6.3) */
+    static bool serverKeyBlock(SSL *ssl, uint8_t *key, size_t keyLength, uint8_t *iv, size_t ivLength) {
+        uint8_t block[2 * (32 + 12)];
+        int blockLength = SSL_get_key_block_len(ssl);
+        if (blockLength != (int) (2 * (keyLength + ivLength)) || !SSL_generate_key_block(ssl, block, (size_t) blockLength)) {
+            return false;
+        }
+        memcpy(key, block + keyLength, keyLength);
+        memcpy(iv, block + 2 * keyLength + ivLength, ivLength);
+        OPENSSL_cleanse(block, sizeof(block));
+        return true;
+    }
+
+#ifdef __linux__
+    /* GCM nonces are a 4 byte salt and 8 bytes that differ per record. TLS 1.3 xors the sequence into the iv it derived,
+     * the kernel does that with the rest of the iv. TLS 1.2 sends those 8 bytes with every record, like BoringSSL we use
+     * the sequence number */
+    static void fillGcmNonce(unsigned char *salt, unsigned char *explicitNonce, const uint8_t *iv, const uint8_t *sequence, bool tls13) {
+        memcpy(salt, iv, 4);
+        memcpy(explicitNonce, tls13 ? iv + 4 : sequence, 8);
+    }
+#endif
+};
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <zlib.h>
+#include <brotli/encode.h>
+#ifdef AKENO_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+#include "akeno/App.h"
+#include "akeno/external/ankerl/unordered_dense.h"
+
+/* Compression levels per WebApp (options.precompress), 0 disables that encoding */
+struct PrecompressOptions {
+    bool enabled = false;
+    int gzip = 6;
+    int brotli = 5;
+    int zstd = 3;
+    /* Smaller files are not worth compressing */
+    size_t minSize = 1024;
+};
+
+/* Empty when that encoding is disabled or didn't make the file smaller */
+struct PrecompressedVariants {
+    std::string gzip;
+    std::string brotli;
+    std::string zstd;
+
+    /* Whether an Accept-Encoding value allows coding, a q of 0 refuses it (RFC 9110 12.5.3) */
+    static bool accepts(std::string_view acceptEncoding, std::string_view coding) {
+        while (acceptEncoding.length()) {
+            size_t comma = acceptEncoding.find(',');
+            std::string_view item = acceptEncoding.substr(0, comma);
+            acceptEncoding = comma == std::string_view::npos ? std::string_view() : acceptEncoding.substr(comma + 1);
+
+            size_t semicolon = item.find(';');
+            std::string_view name = item.substr(0, semicolon);
+            while (name.length() && name.front() == ' ') name.remove_prefix(1);
+            while (name.length() && name.back() == ' ') name.remove_suffix(1);
+            if (name.length() != coding.length() || !std::equal(name.begin(), name.end(), coding.begin(), [](char a, char b) { return (a | 0x20) == b; })) {
+                continue;
+            }
+
+            if (semicolon == std::string_view::npos) {
+                return true;
+            }
+            std::string_view params = item.substr(semicolon + 1);
+            size_t q = params.find("q=");
+            if (q == std::string_view::npos) {
+                return true;
+            }
+            /* "0", "0.", "0.0" up to "0.000" */
+            std::string_view value = params.substr(q + 2);
+            size_t end = value.find_first_not_of("0.");
+            return !(value.length() && value[0] == '0' && (end == std::string_view::npos || value[end] == ' ' || value[end] == ';'));
+        }
+        return false;
+    }
+
+    /* Whether a response may get content coded on the fly */
+    static bool acceptsAny(std::string_view acceptEncoding) {
+        return accepts(acceptEncoding, "br") || accepts(acceptEncoding, "zstd") || accepts(acceptEncoding, "gzip") || accepts(acceptEncoding, "deflate");
+    }
+
+    /* The smallest variant the client accepts, empty if there is none. encoding is set to its Content-Encoding */
+    std::string_view select(std::string_view acceptEncoding, std::string_view &encoding) const {
+        std::string_view best;
+        auto consider = [&](const std::string &variant, std::string_view coding) {
+            if (variant.length() && (best.empty() || variant.length() < best.length()) && accepts(acceptEncoding, coding)) {
+                best = variant;
+                encoding = coding;
+            }
+        };
+
+        consider(brotli, "br");
+        consider(zstd, "zstd");
+        consider(gzip, "gzip");
+        return best;
+    }
+};
+
+/* Worker threads that compress files off the event loop, results are handed back with Loop::defer */
+struct PrecompressionPool {
+    struct Job {
+        std::shared_ptr<const std::string> data;
+        PrecompressOptions options;
+        uWS::MoveOnlyFunction<void(PrecompressedVariants &&)> done;
+    };
+
+    uWS::Loop *loop = nullptr;
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Job> jobs;
+    bool stopping = false;
+
+    ~PrecompressionPool() {
+        stop();
+    }
+
+    static std::string gzip(std::string_view in, int level) {
+        z_stream stream = {};
+        if (deflateInit2(&stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return {};
+        }
+
+        std::string out(deflateBound(&stream, in.length()), '\0');
+        stream.next_in = (Bytef *) in.data();
+        stream.avail_in = (uInt) in.length();
+        stream.next_out = (Bytef *) out.data();
+        stream.avail_out = (uInt) out.length();
+
+        bool ok = deflate(&stream, Z_FINISH) == Z_STREAM_END;
+        out.resize(stream.total_out);
+        deflateEnd(&stream);
+        return ok ? out : std::string();
+    }
+
+    static std::string brotli(std::string_view in, int quality) {
+        size_t length = BrotliEncoderMaxCompressedSize(in.length());
+        if (!length) {
+            return {};
+        }
+
+        std::string out(length, '\0');
+        if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, in.length(), (const uint8_t *) in.data(), &length, (uint8_t *) out.data())) {
+            return {};
+        }
+        out.resize(length);
+        return out;
+    }
+
+    static std::string zstd(std::string_view in, int level) {
+#ifdef AKENO_WITH_ZSTD
+        std::string out(ZSTD_compressBound(in.length()), '\0');
+        size_t length = ZSTD_compress(out.data(), out.length(), in.data(), in.length(), level);
+        if (ZSTD_isError(length)) {
+            return {};
+        }
+        out.resize(length);
+        return out;
+#else
+        return {};
+#endif
+    }
+
+    static PrecompressedVariants compress(std::string_view in, const PrecompressOptions &options) {
+        PrecompressedVariants variants;
+
+        /* A variant that isn't smaller is useless */
+        auto keep = [&](std::string &&variant) {
+            return variant.length() < in.length() ? std::move(variant) : std::string();
+        };
+
+        if (options.gzip > 0) {
+            variants.gzip = keep(gzip(in, options.gzip));
+        }
+        if (options.brotli > 0) {
+            variants.brotli = keep(brotli(in, options.brotli));
+        }
+        if (options.zstd > 0) {
+            variants.zstd = keep(zstd(in, options.zstd));
+        }
+        return variants;
+    }
+
+    /* Threads are started with the first job */
+    void push(Job &&job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (threads.empty()) {
+                unsigned int count = std::max(1u, std::min(4u, std::thread::hardware_concurrency() / 2));
+                for (unsigned int i = 0; i < count; i++) {
+                    threads.emplace_back([this]() { work(); });
+                }
+            }
+            jobs.push_back(std::move(job));
+        }
+        condition.notify_one();
+    }
+
+    void work() {
+        while (true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (stopping) {
+                    return;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            PrecompressedVariants variants = compress(*job.data, job.options);
+
+            loop->defer([done = std::move(job.done), variants = std::move(variants)]() mutable {
+                done(std::move(variants));
+            });
+        }
+    }
+
+    /* Drops queued jobs and joins, must happen before the loop is freed */
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            jobs.clear();
+        }
+        condition.notify_all();
+
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+        threads.clear();
+    }
+};
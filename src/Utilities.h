@@ -23,8 +23,17 @@
 #include <memory>
 #include <unordered_map>
 #include "akeno/external/ankerl/unordered_dense.h"
+#include "CacheBudget.h"
+#include "FileWatcher.h"
 using namespace v8;
 
+/* Fast calls are built against the header of the target's own V8 (include/node of each target), whose structures match the
+ * V8 they run in. See fastCallsCanFallBack for which targets actually register them */
+#if !defined(AKENO_NO_FAST_API) && __has_include(<v8-fast-api-calls.h>)
+#include <v8-fast-api-calls.h>
+#define AKENO_FAST_API
+#endif
+
 namespace uWS {
     struct App;
 }
@@ -36,13 +45,93 @@ namespace Akeno {
 /* Unfortunately we _have_ to depend on Node.js crap */
 #include <node.h>
 
+/* While no async hook or AsyncLocalStorage is active, CallJS skips node::MakeCallback and calls the function directly.
+ * Ticks and microtasks queued by calls from socket events then run once per loop iteration, see drain */
+struct DirectCallState {
+    /* async_wrap's async_hook_fields as registered from uws.js, kept alive by its backing store */
+    std::shared_ptr<BackingStore> asyncHookFieldsStore;
+    uint32_t *asyncHookFields = nullptr;
+    uint32_t kTotals = 0, kUsesExecutionAsyncResource = 0;
+
+    /* Depth of direct calls, only the outermost one drains or leaves that to drain */
+    int depth = 0;
+    /* Set by the loop's pre handler until drain ran. Calls outside of that (libuv timers, post handlers running
+     * after drain) drain right away, so nothing they queue waits for the next wakeup */
+    bool batching = false;
+    bool pendingDrain = false;
+    /* Fast calls leave writes to the slow path while drain runs JS */
+    bool draining = false;
+
+    bool canCallDirectly() {
+        return asyncHookFields && !asyncHookFields[kTotals] && !asyncHookFields[kUsesExecutionAsyncResource];
+    }
+
+    /* An empty scope runs ticks and microtasks on close, and does nothing while Node.js itself is running JS
+     * further up the stack, it drains once that returns */
+    void drainNow(Isolate *isolate) {
+        node::CallbackScope scope(isolate, isolate->GetCurrentContext()->Global(), {0, 0});
+    }
+
+    /* From the loop's post handler, once for all calls of the iteration. The JS that queued the work ran corked,
+     * so does the work: uWS corks every response written to on its own and uncorks it by the end of the iteration */
+    void drain(Isolate *isolate) {
+        extern thread_local int insideCorkCallback;
+        batching = false;
+        if (!pendingDrain) {
+            return;
+        }
+        pendingDrain = false;
+
+        HandleScope hs(isolate);
+        insideCorkCallback++;
+        draining = true;
+        drainNow(isolate);
+        draining = false;
+        insideCorkCallback--;
+    }
+};
+
+/* Since Node.js 24 (and with --experimental-async-context-frame on 22), AsyncLocalStorage lives in V8's continuation
+ * preserved embedder data and leaves async_hook_fields alone. MakeCallback enters an empty frame and restores the
+ * previous one after the call, the direct path does the same. Older V8 has no such API and no frames */
+template <class I>
+static inline Local<Value> exchangeContextFrame(I *isolate, Local<Value> frame) {
+    if constexpr (requires { isolate->GetContinuationPreservedEmbedderData(); }) {
+        Local<Value> prior = isolate->GetContinuationPreservedEmbedderData();
+        isolate->SetContinuationPreservedEmbedderData(frame);
+        return prior;
+    } else {
+        return frame;
+    }
+}
+
+thread_local DirectCallState *directCallState = nullptr;
+
 MaybeLocal<Value> CallJS(Isolate *isolate, Local<Function> f, int argc, Local<Value> *argv) {
-    extern int calledIntoJS;
+    extern thread_local uint64_t calledIntoJS;
     extern thread_local int insideCorkCallback;
+    calledIntoJS++;
     /* All calls we do into JS are properly corked, except for res.cork, where we increase the counter explicitly */
     insideCorkCallback++;
-    /* Slow path */
-    auto ret = node::MakeCallback(isolate, isolate->GetCurrentContext()->Global(), f, argc, argv, {0, 0});
+    MaybeLocal<Value> ret;
+    if (directCallState && directCallState->canCallDirectly()) {
+        /* Fast path. Same as with MakeCallback, an exception propagates to the calling JS if there is any
+         * (parser hooks, close handlers of ws.end) and is reported as uncaught otherwise */
+        directCallState->depth++;
+        Local<Value> frame = exchangeContextFrame(isolate, Undefined(isolate).As<Value>());
+        ret = f->Call(isolate->GetCurrentContext(), isolate->GetCurrentContext()->Global(), argc, argv);
+        exchangeContextFrame(isolate, frame);
+        if (--directCallState->depth == 0) {
+            if (directCallState->batching) {
+                directCallState->pendingDrain = true;
+            } else if (!ret.IsEmpty()) {
+                directCallState->drainNow(isolate);
+            }
+        }
+    } else {
+        /* Slow path */
+        ret = node::MakeCallback(isolate, isolate->GetCurrentContext()->Global(), f, argc, argv, {0, 0});
+    }
     insideCorkCallback--;
     return ret;
 }
@@ -58,8 +147,84 @@ Local<v8::ArrayBuffer> ArrayBuffer_NewCopy(Isolate *isolate, void *data, size_t
     return ab;
 }
 
+/* Per-loop receive arena for the opt-in reuseBuffers mode. Received chunks are copied into one native buffer
+ * and handed to JS as Uint8Array views of it, so there is no BackingStore per chunk. The ArrayBuffer behind
+ * the views is detached after each loop iteration instead of after each callback: views still become
+ * unusable, but never observe data of a later chunk since the arena only grows within an iteration */
+struct ReceiveArena {
+    static constexpr size_t kCapacity = 256 * 1024;
+    /* Larger chunks are not worth the copy and take the regular path */
+    static constexpr size_t kMaxChunk = 16 * 1024;
+
+    Isolate *isolate = nullptr;
+    std::unique_ptr<char[]> storage;
+    size_t offset = 0;
+    Global<ArrayBuffer> buffer;
+
+    /* Returns a view of a copy of data, or an empty handle if it does not fit this iteration */
+    Local<Uint8Array> view(std::string_view data) {
+        if (data.length() > kMaxChunk || offset + data.length() > kCapacity) {
+            return {};
+        }
+
+        if (buffer.IsEmpty()) {
+            if (!storage) {
+                storage.reset(new char[kCapacity]);
+            }
+            buffer.Reset(isolate, ArrayBuffer_New(isolate, storage.get(), kCapacity));
+        }
+
+        memcpy(storage.get() + offset, data.data(), data.length());
+        Local<Uint8Array> view = Uint8Array::New(buffer.Get(isolate), offset, data.length());
+        offset += data.length();
+        return view;
+    }
+
+    /* From the loop's post handler, after ticks and microtasks of the iteration ran (see Main) */
+    void detach() {
+        if (!buffer.IsEmpty()) {
+            HandleScope hs(isolate);
+            buffer.Get(isolate)->Detach();
+            buffer.Reset();
+        }
+        offset = 0;
+    }
+};
+
+/* Received data as passed to JS, backed either by the arena or by an ArrayBuffer over uWS memory that
+ * has to be detached once the callback returned. Call detach() in both cases. With an arena (reuseBuffers)
+ * the value is always a Uint8Array, chunks that don't fit get a view of their whole ArrayBuffer */
+struct ReceivedData {
+    Local<Value> value;
+    Local<ArrayBuffer> arrayBuffer;
+
+    ReceivedData(Isolate *isolate, ReceiveArena *arena, std::string_view data) {
+        if (arena) {
+            Local<Uint8Array> view = arena->view(data);
+            if (!view.IsEmpty()) {
+                value = view;
+                return;
+            }
+        }
+        arrayBuffer = ArrayBuffer_New(isolate, (void *) data.data(), data.length());
+        if (arena) {
+            value = Uint8Array::New(arrayBuffer, 0, data.length());
+        } else {
+            value = arrayBuffer;
+        }
+    }
+
+    void detach() {
+        if (!arrayBuffer.IsEmpty()) {
+            arrayBuffer->Detach();
+        }
+    }
+};
+
 struct PerSocketData {
     Global<Object> socketPf;
+    /* send() may close the socket (and call into JS) when this is set, so it disables the fast call path */
+    bool closeOnBackpressureLimit = false;
 };
 
 struct PerContextData {
@@ -68,33 +233,90 @@ struct PerContextData {
     Global<Object> resTemplate[4]; // 0 = non-SSL, 1 = SSL, 2 = Http3
     Global<Object> wsTemplate[2];
 
+    /* Cloned for every parser.compile result */
+    Global<Object> htmlTemplate;
+
+    /* Recycled wrappers for routes registered with { pooled: true }, see acquireReqResObjects */
+    Global<Object> pooledReqTemplate;
+    std::vector<Global<Object>> reqPool;
+    std::vector<Global<Object>> resPool[2];
+
+    /* Shared by res.onData and ws() routes with reuseBuffers */
+    ReceiveArena receiveArena;
+
+    DirectCallState directCallState;
+
     /* We hold all apps and protocols until free */
     std::vector<std::unique_ptr<uWS::App>> apps;
     std::vector<std::unique_ptr<uWS::HTTPProtocol>> protocols;
     std::vector<std::unique_ptr<uWS::HTTPSProtocol>> sslProtocols;
 
+    /* HTTPSProtocols created with ktls, and the socket contexts they listen with, see FileStream */
+    ankerl::unordered_dense::set<void *> ktlsProtocols;
+    ankerl::unordered_dense::set<us_socket_context_t *> ktlsContexts;
+
     std::unordered_map<uWS::App *, std::shared_ptr<Global<Function>>> appObjectCallbacks;
 
     /* WebApp instances created from JS (kept alive for the isolate lifetime) */
     ankerl::unordered_dense::map<Akeno::WebApp *, std::shared_ptr<Akeno::WebApp>> webAppsByPtr;
 
+    /* Background compression of processed files, see WebApp options.precompress */
+    PrecompressionPool precompressionPool;
+
+    /* Addon side of every WebApp's FileCache */
+    ankerl::unordered_dense::map<Akeno::WebApp *, WebAppCache> webAppCaches;
+
+    /* Something cached that has to be redone when one of its files changes, see invalidateFile.
+     * Either a WebApp file (processed again right away) or an HTMLParser file (marked in changed) */
+    struct FileDependent {
+        Akeno::WebApp *webApp = nullptr;
+        ankerl::unordered_dense::set<std::string> *changed = nullptr;
+        std::string fullPath;
+        std::string url;
+        std::string mimeType;
+    };
+
+    FileWatcher fileWatcher;
+    /* By normalized path of the changing file, including the dependent's own path */
+    ankerl::unordered_dense::map<std::string, std::vector<FileDependent>> fileDependents;
+    /* WebApp files whose sources changed, by WebApp and full path. Processed again together once staleFilesTimer fires */
+    ankerl::unordered_dense::map<std::string, FileDependent> staleFiles;
+    uv_timer_t *staleFilesTimer = nullptr;
+
     /* File processor callback and pending responses for async refresh */
     std::shared_ptr<Global<Function>> fileProcessorCallback;
     uint64_t nextFileProcessId = 1;
 
-    struct PendingFileProcess {
+    /* A request waiting for a file to be processed, res is nullptr once aborted */
+    struct PendingFileRequest {
         bool ssl = false;
         void *res = nullptr;
+        std::string status;
+        int variant = 0;
+        /* Conditional and range headers, the response may turn into a 304 or 206 once the file is processed */
+        std::string ifNoneMatch;
+        std::string ifModifiedSince;
+        std::string range;
+        std::string ifRange;
+        /* Picks the precompressed variant, if there is one by the time the file is processed */
+        std::string acceptEncoding;
+    };
+
+    /* One processing job per file, concurrent misses for the same file wait on it instead of starting their own */
+    struct PendingFileProcess {
         Akeno::WebApp *webApp = nullptr;
         std::string url;
         std::string fullPath;
         std::string mimeType;
-        std::string ifNoneMatch;
-        std::string status;
-        int variant = 0;
+        std::vector<PendingFileRequest> requests;
+        /* completeProcessing(id, true) is reading the file, the job is already completed */
+        bool reading = false;
     };
 
     ankerl::unordered_dense::map<uint64_t, PendingFileProcess> pendingFileProcesses;
+
+    /* Job id by WebApp and full path, see startFileProcess */
+    ankerl::unordered_dense::map<std::string, uint64_t> pendingFileProcessIds;
 };
 
 /* Returns the resTemplate / wsTemplate index for a protocol type.
@@ -148,11 +370,32 @@ struct Callback {
     }
 };
 
+/* Plain ASCII is the same in Latin-1 (one-byte strings) and UTF-8 */
+static inline bool isAscii(const char *string, size_t length) {
+    const unsigned char *data = (const unsigned char *) string;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        if (word & 0x8080808080808080ull) {
+            return false;
+        }
+    }
+    for (; i < length; i++) {
+        if (data[i] & 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
 class NativeString {
     char *data;
     size_t length;
     char utf8ValueMemory[sizeof(String::Utf8Value)];
     String::Utf8Value *utf8Value = nullptr;
+    /* Buffer memory stays allocated while it is read, even if JS detaches or transfers the buffer meanwhile */
+    std::shared_ptr<BackingStore> backingStore;
     bool invalid = false;
 public:
     NativeString(Isolate *isolate, const Local<Value> &value) {
@@ -160,24 +403,31 @@ public:
             data = nullptr;
             length = 0;
         } else if (value->IsString()) {
-            utf8Value = new (utf8ValueMemory) String::Utf8Value(isolate, value);
-            data = (**utf8Value);
-            length = utf8Value->length();
+            /* External one-byte strings are used in place, if they are ASCII and thus already UTF-8 */
+            const String::ExternalOneByteStringResource *external = Local<String>::Cast(value)->IsExternalOneByte() ? Local<String>::Cast(value)->GetExternalOneByteStringResource() : nullptr;
+            if (external && isAscii(external->data(), external->length())) {
+                data = (char *) external->data();
+                length = external->length();
+            } else {
+                utf8Value = new (utf8ValueMemory) String::Utf8Value(isolate, value);
+                data = (**utf8Value);
+                length = utf8Value->length();
+            }
         } else if (value->IsTypedArray()) {
             Local<ArrayBufferView> arrayBufferView = Local<ArrayBufferView>::Cast(value);
-            auto contents = arrayBufferView->Buffer()->GetBackingStore();
+            backingStore = arrayBufferView->Buffer()->GetBackingStore();
             length = arrayBufferView->ByteLength();
-            data = (char *) contents->Data() + arrayBufferView->ByteOffset();
+            data = (char *) backingStore->Data() + arrayBufferView->ByteOffset();
         } else if (value->IsArrayBuffer()) {
             Local<ArrayBuffer> arrayBuffer = Local<ArrayBuffer>::Cast(value);
-            auto contents = arrayBuffer->GetBackingStore();
-            length = contents->ByteLength();
-            data = (char *) contents->Data();
+            backingStore = arrayBuffer->GetBackingStore();
+            length = backingStore->ByteLength();
+            data = (char *) backingStore->Data();
         } else if (value->IsSharedArrayBuffer()) {
             Local<SharedArrayBuffer> arrayBuffer = Local<SharedArrayBuffer>::Cast(value);
-            auto contents = arrayBuffer->GetBackingStore();
-            length = contents->ByteLength();
-            data = (char *) contents->Data();
+            backingStore = arrayBuffer->GetBackingStore();
+            length = backingStore->ByteLength();
+            data = (char *) backingStore->Data();
         } else {
             invalid = true;
         }
@@ -194,6 +444,11 @@ public:
         return {data, length};
     }
 
+    /* Whether the data is JS buffer memory, which JS may still write to */
+    bool isBuffer() {
+        return backingStore != nullptr;
+    }
+
     ~NativeString() {
         if (utf8Value) {
             utf8Value->~Utf8Value();
@@ -201,6 +456,53 @@ public:
     }
 };
 
+#ifdef AKENO_FAST_API
+/* Our fast calls hand whatever they can't do (detached objects, writes that may run JS, non-ASCII strings) to the slow callback
+ * through FastApiCallbackOptions::fallback. The V8 of Node.js 20 and 22 has it, newer V8 (Node.js 24+) removed it, and
+ * there the fast calls could not fall back, so those targets keep only the regular callbacks. Decided per target header */
+template <class Options>
+constexpr bool fastCallsCanFallBack = requires(Options &options) { options.fallback = true; };
+
+template <class Options>
+static inline void fallBack(Options &options) {
+    if constexpr (fastCallsCanFallBack<Options>) {
+        options.fallback = true;
+    }
+}
+
+/* Fast call strings are Latin-1, we only take them as-is when they are plain ASCII (and thus identical to UTF-8) */
+static inline bool isAsciiOneByte(const FastOneByteString &string) {
+    return isAscii(string.data, string.length);
+}
+
+/* Creates a function template with fast call overloads (picked by arity), the regular callback stays as the slow path */
+template <size_t N>
+static inline Local<FunctionTemplate> FunctionTemplate_NewFast(Isolate *isolate, FunctionCallback slowCallback, const CFunction (&overloads)[N]) {
+    if constexpr (!fastCallsCanFallBack<FastApiCallbackOptions>) {
+        return FunctionTemplate::New(isolate, slowCallback);
+    }
+    return FunctionTemplate::NewWithCFunctionOverloads(isolate, slowCallback, Local<Value>(), Local<Signature>(), 0,
+        ConstructorBehavior::kThrow, SideEffectType::kHasSideEffect, MemorySpan<const CFunction>(overloads, N));
+}
+
+/* Fast calls cannot return objects, so methods returning this are shadowed on the prototype
+ * by a tiny JS shim. TurboFan inlines it, keeping the fast call underneath */
+static inline void shimReturnThis(Isolate *isolate, Local<Object> prototype, const char *name) {
+    if constexpr (!fastCallsCanFallBack<FastApiCallbackOptions>) {
+        return;
+    }
+    Local<Context> context = isolate->GetCurrentContext();
+    Local<String> source = String::NewFromUtf8(isolate, "(function (f) { return function (a, b) { if (b === undefined) f.call(this, a); else f.call(this, a, b); return this; }; })", NewStringType::kNormal).ToLocalChecked();
+    Local<Function> factory = Local<Function>::Cast(Script::Compile(context, source).ToLocalChecked()->Run(context).ToLocalChecked());
+
+    Local<String> key = String::NewFromUtf8(isolate, name, NewStringType::kInternalized).ToLocalChecked();
+    Local<Value> argv[] = {prototype->Get(context, key).ToLocalChecked()};
+    Local<Function> shim = Local<Function>::Cast(factory->Call(context, Undefined(isolate), 1, argv).ToLocalChecked());
+    shim->SetName(key);
+    prototype->Set(context, key, shim).ToChecked();
+}
+#endif
+
 // Utility function to extract raw certificate data
 std::string extractX509PemCertificate(SSL* ssl) {
     std::string pemCertificate;
@@ -238,6 +238,31 @@ struct WebSocketWrapper {
         }
     }
 
+#ifdef AKENO_FAST_API
+    /* Fast call send(message, isBinary, compress). Anything that could call back into JS
+     * (dropped or close handlers under backpressure) is left to the slow path */
+    template <bool SSL>
+    static uint32_t uWS_WebSocket_send_fast(Local<Object> receiver, const FastOneByteString &message, bool isBinary, bool compress, FastApiCallbackOptions &options) {
+        auto *ws = (uWS::WebSocket<SSL, true, PerSocketData> *) receiver->GetAlignedPointerFromInternalField(0);
+        if (!ws || ws->getUserData()->closeOnBackpressureLimit || ws->getBufferedAmount() || !isAsciiOneByte(message)) {
+            fallBack(options);
+            return 0;
+        }
+
+        return ws->send({message.data, message.length}, isBinary ? uWS::OpCode::BINARY : uWS::OpCode::TEXT, compress);
+    }
+
+    template <bool SSL>
+    static uint32_t uWS_WebSocket_sendText_fast(Local<Object> receiver, const FastOneByteString &message, FastApiCallbackOptions &options) {
+        return uWS_WebSocket_send_fast<SSL>(receiver, message, false, false, options);
+    }
+
+    template <bool SSL>
+    static uint32_t uWS_WebSocket_sendUncompressed_fast(Local<Object> receiver, const FastOneByteString &message, bool isBinary, FastApiCallbackOptions &options) {
+        return uWS_WebSocket_send_fast<SSL>(receiver, message, isBinary, false, options);
+    }
+#endif
+
     /* Takes topic string, returns bool */
     template <bool SSL>
     static void uWS_WebSocket_isSubscribed(const FunctionCallbackInfo<Value> &args) {
@@ -324,7 +349,12 @@ struct WebSocketWrapper {
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "sendLastFragment", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_sendLastFragment<SSL>));
 
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getUserData", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_getUserData<SSL>));
+#ifdef AKENO_FAST_API
+        static const CFunction sendOverloads[] = {CFunction::Make(uWS_WebSocket_sendText_fast<SSL>), CFunction::Make(uWS_WebSocket_sendUncompressed_fast<SSL>), CFunction::Make(uWS_WebSocket_send_fast<SSL>)};
+        wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "send", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate_NewFast(isolate, uWS_WebSocket_send<SSL>, sendOverloads));
+#else
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "send", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_send<SSL>));
+#endif
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "end", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_end<SSL>));
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "close", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_close<SSL>));
         wsTemplateLocal->PrototypeTemplate()->Set(String::NewFromUtf8(isolate, "getBufferedAmount", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_WebSocket_getBufferedAmount<SSL>));
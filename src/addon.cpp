@@ -55,33 +55,6 @@ Akeno::DomainRouter<DomainHandler> domainRouter;
 
 /* Todo: Apps should be freed once the GC says so BUT ALWAYS before freeing the loop */
 
-/* Definition of getReqKeys needed by AppWrapper.h */
-constexpr int kReqKeysSlot = 1; // FIXME: ? I am unsure about the right way to do this.
-ReqKeys &getReqKeys(v8::Isolate *isolate) {
-    void *p = isolate->GetData(kReqKeysSlot);
-    if (p)
-        return *static_cast<ReqKeys *>(p);
-
-    auto *keys = new ReqKeys();
-
-    auto mk = [&](const char *s) {
-        return v8::String::NewFromUtf8(isolate, s, v8::NewStringType::kInternalized)
-            .ToLocalChecked();
-    };
-
-    keys->method.Set(isolate, mk("method"));
-    keys->origin.Set(isolate, mk("origin"));
-    keys->secure.Set(isolate, mk("secure"));
-    keys->host.Set(isolate, mk("host"));
-    keys->domain.Set(isolate, mk("domain"));
-    keys->path.Set(isolate, mk("path"));
-    keys->contentType.Set(isolate, mk("contentType"));
-    keys->contentLength.Set(isolate, mk("contentLength"));
-
-    isolate->SetData(kReqKeysSlot, keys);
-    return *keys;
-}
-
 #include "Multipart.h"
 
 /* This function is somewhat of a simplifying wrapper that does not follow the C++ library.
@@ -192,6 +165,41 @@ void uWS_clearTimeout(const FunctionCallbackInfo<Value> &args) {
     //timerCallbacksJS[timer].Reset();
 }
 
+/* Number of calls into JS on this thread (loop), see CallJS */
+thread_local uint64_t calledIntoJS = 0;
+
+/* Takes nothing, returns number */
+void uWS_getCalledIntoJS(const FunctionCallbackInfo<Value> &args) {
+    args.GetReturnValue().Set(Number::New(args.GetIsolate(), (double) calledIntoJS));
+}
+
+/* Takes Uint32Array (async_wrap's async_hook_fields), kTotals and kUsesExecutionAsyncResource indices. Enables direct calls into JS */
+void uWS_setAsyncHookFields(const FunctionCallbackInfo<Value> &args) {
+    Isolate *isolate = args.GetIsolate();
+    if (missingArguments(3, args)) {
+        return;
+    }
+
+    if (!args[0]->IsUint32Array()) {
+        args.GetReturnValue().Set(isolate->ThrowException(v8::Exception::Error(String::NewFromUtf8(isolate, "Async hook fields must be an Uint32Array.", NewStringType::kNormal).ToLocalChecked())));
+        return;
+    }
+
+    Local<Uint32Array> fields = Local<Uint32Array>::Cast(args[0]);
+    uint32_t kTotals = args[1]->Uint32Value(isolate->GetCurrentContext()).FromMaybe(0);
+    uint32_t kUsesExecutionAsyncResource = args[2]->Uint32Value(isolate->GetCurrentContext()).FromMaybe(0);
+    if (kTotals >= fields->Length() || kUsesExecutionAsyncResource >= fields->Length()) {
+        return;
+    }
+
+    PerContextData *perContextData = (PerContextData *) Local<External>::Cast(args.Data())->Value();
+    DirectCallState &state = perContextData->directCallState;
+    state.asyncHookFieldsStore = fields->Buffer()->GetBackingStore();
+    state.asyncHookFields = (uint32_t *) ((char *) state.asyncHookFieldsStore->Data() + fields->ByteOffset());
+    state.kTotals = kTotals;
+    state.kUsesExecutionAsyncResource = kUsesExecutionAsyncResource;
+}
+
 /* Pass various undocumented configs */
 void uWS_cfg(const FunctionCallbackInfo<Value> &args) {
     NativeString key(args.GetIsolate(), args[0]);
@@ -422,17 +430,38 @@ PerContextData *Main(Local<Object> exports) {
     /* Init the template objects, SSL and non-SSL, store it in per context data */
     PerContextData *perContextData = new PerContextData;
     perContextData->isolate = isolate;
+    perContextData->receiveArena.isolate = isolate;
+    perContextData->precompressionPool.loop = uWS::Loop::get();
+    perContextData->fileWatcher.onChange = [perContextData](const std::string &path) {
+        invalidateFile(perContextData, path);
+    };
+
+    /* Refer to per context data via External */
+    Local<External> externalPerContextData = External::New(isolate, perContextData);
+
+    /* Calls into JS skip MakeCallback while no async hooks are active, see CallJS */
+    directCallState = &perContextData->directCallState;
+
+    /* Ticks and microtasks of direct calls made during the iteration run once at its end, before the receive
+     * arena is detached so they can still read what the calls were given */
+    uWS::Loop::get()->addPreHandler(&perContextData->directCallState, [perContextData](uWS::Loop *) {
+        perContextData->directCallState.batching = true;
+    });
+    uWS::Loop::get()->addPostHandler(&perContextData->directCallState, [perContextData](uWS::Loop *) {
+        perContextData->directCallState.drain(perContextData->isolate);
+        perContextData->receiveArena.detach();
+    });
+
     perContextData->reqTemplate[0].Reset(isolate, HttpRequestWrapper::init<false>(isolate));
     perContextData->reqTemplate[1].Reset(isolate, HttpRequestWrapper::init<true>(isolate));
-    perContextData->resTemplate[0].Reset(isolate, HttpResponseWrapper::init<0>(isolate));
-    perContextData->resTemplate[1].Reset(isolate, HttpResponseWrapper::init<1>(isolate));
-    perContextData->resTemplate[2].Reset(isolate, HttpResponseWrapper::init<2>(isolate));
-    perContextData->resTemplate[3].Reset(isolate, HttpResponseWrapper::init<3>(isolate));
+    perContextData->pooledReqTemplate.Reset(isolate, HttpRequestWrapper::init<false>(isolate, true));
+    perContextData->resTemplate[0].Reset(isolate, HttpResponseWrapper::init<0>(isolate, externalPerContextData));
+    perContextData->resTemplate[1].Reset(isolate, HttpResponseWrapper::init<1>(isolate, externalPerContextData));
+    perContextData->resTemplate[2].Reset(isolate, HttpResponseWrapper::init<2>(isolate, externalPerContextData));
+    perContextData->resTemplate[3].Reset(isolate, HttpResponseWrapper::init<3>(isolate, externalPerContextData));
     perContextData->wsTemplate[0].Reset(isolate, WebSocketWrapper::init<0>(isolate));
     perContextData->wsTemplate[1].Reset(isolate, WebSocketWrapper::init<1>(isolate));
-
-    /* Refer to per context data via External */
-    Local<External> externalPerContextData = External::New(isolate, perContextData);
+    perContextData->htmlTemplate.Reset(isolate, initHTMLTemplate(isolate));
 
     /* App - protocol-agnostic routing context */
     exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "App", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_App_constructor, externalPerContextData)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
@@ -472,6 +501,8 @@ PerContextData *Main(Local<Object> exports) {
 
     exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "_cfg", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_cfg)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
     exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "getParts", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_getParts)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
+    exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "setAsyncHookFields", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_setAsyncHookFields, externalPerContextData)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
+    exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "getCalledIntoJS", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_getCalledIntoJS)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
     
     /* Expose some µSockets functions directly under uWS namespace */
     exports->Set(isolate->GetCurrentContext(), String::NewFromUtf8(isolate, "us_listen_socket_close", NewStringType::kNormal).ToLocalChecked(), FunctionTemplate::New(isolate, uWS_us_listen_socket_close)->GetFunction(isolate->GetCurrentContext()).ToLocalChecked()).ToChecked();
@@ -527,6 +558,15 @@ NODE_MODULE_INITIALIZER(Local<Object> exports, Local<Value> module, Local<Contex
 
         PerContextData *perContextData = (PerContextData *) arg;
 
+        /* No compression results may be deferred to a freed loop */
+        perContextData->precompressionPool.stop();
+        perContextData->fileWatcher.stop();
+        if (perContextData->staleFilesTimer) {
+            uv_close((uv_handle_t *) perContextData->staleFilesTimer, [](uv_handle_t *handle) {
+                delete (uv_timer_t *) handle;
+            });
+        }
+
         /* Freeing protocols first (they detach from apps), then apps */
         perContextData->protocols.clear();
         perContextData->sslProtocols.clear();
@@ -535,6 +575,7 @@ NODE_MODULE_INITIALIZER(Local<Object> exports, Local<Value> module, Local<Contex
         uWS::Loop::get()->free();
 
         /* We can safely delete this since we no longer can call uWS.free */
+        directCallState = nullptr;
         delete perContextData;
 
     }, perContextData);
@@ -23,6 +23,19 @@ module.exports = (() => {
 	}
 })();
 
+/* Lets native calls into JS skip node::MakeCallback while no async hooks or AsyncLocalStorage are active
+ * (AsyncLocalStorage on AsyncContextFrame, Node.js 24+, is handled natively, see CallJS).
+ * process.binding is deprecated (DEP0111, a runtime warning with --pending-deprecation) and only used on the
+ * Node.js versions this build supports, where async_wrap is still on its allow list. Anywhere else, or without
+ * access to the hook counters, every call keeps using MakeCallback */
+const nodeMajor = parseInt(process.versions.node);
+if (nodeMajor >= 20 && nodeMajor <= 25 && !process.execArgv.includes('--pending-deprecation')) {
+	try {
+		const { async_hook_fields, constants } = process.binding('async_wrap');
+		module.exports.setAsyncHookFields(async_hook_fields, constants.kTotals, constants.kUsesExecutionAsyncResource);
+	} catch (e) {}
+}
+
 module.exports.DeclarativeResponse = class DeclarativeResponse {
   constructor() {
     this.instructions = [];
@@ -56,6 +69,9 @@ module.exports.DeclarativeResponse = class DeclarativeResponse {
     const bytes = new TextEncoder().encode(value);
     const length = bytes.length;
     this.instructions.push(0, length & 0xff, (length >> 8) & 0xff, ...bytes);
-    return new Uint8Array(this.instructions).buffer;
+    const program = new Uint8Array(this.instructions).buffer;
+    // Tells app.route() to run this program natively instead of serving it as a static buffer
+    program[Symbol.for('uWS.DeclarativeResponse')] = true;
+    return program;
   }
 }
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "../src/CharScan.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// Bulid with
+// (need to have Google Benchmark installed, on Fedora that is `dnf install google-benchmark google-benchmark-devel`)
+// g++ -O3 -DNDEBUG -std=c++20 ParserTests.cpp -lbenchmark -lpthread -o ParserTests
+// Run from this directory, it reads akeno/misc/test.html
+// The checks below don't use assert, so they still run with -DNDEBUG
+
+// Measures CharScan against byte by byte and libc scans, in MB/s. The SSE2/AVX2/NEON paths have no caller in the addon
+// yet, the only one is contains<'@'> in onText, which goes to memchr. These numbers are what wiring them into the
+// tokenizer would have to beat
+
+// Byte by byte, what the scanners replace
+static size_t ScalarHTMLStructural(std::string_view data, size_t from) {
+    for (size_t i = from; i < data.length(); i++) {
+        char c = data[i];
+        if (c == '<' || c == '>' || c == '@' || c == '"' || c == '\'') {
+            return i;
+        }
+    }
+    return std::string_view::npos;
+}
+
+// Reports the failed condition and makes runTests fail
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << "  [FAIL] line " << __LINE__ << ": " #condition << std::endl; \
+            return 1; \
+        } \
+    } while (0)
+
+int runTests() {
+    std::cout << "Running Tests..." << std::endl;
+
+    {
+        // 1. Every position and every length, so the vector bodies and scalar tails all get hit
+        std::string data(200, 'a');
+        for (size_t position = 0; position < data.length(); position++) {
+            for (char c : {'<', '>', '@', '"', '\''}) {
+                data[position] = c;
+                for (size_t from = 0; from <= position; from += 7) {
+                    CHECK(CharScan::findHTMLStructural(data, from) == position);
+                }
+                CHECK(CharScan::findHTMLStructural(std::string_view(data).substr(0, position)) == std::string_view::npos);
+                data[position] = 'a';
+            }
+        }
+        std::cout << "  [PASS] Positions" << std::endl;
+    }
+
+    {
+        // 2. forEach sees the same hits as repeated findFirstOf
+        std::string data;
+        for (int i = 0; i < 1000; i++) {
+            data += (i % 13 == 0) ? '<' : (i % 29 == 0) ? '@' : (i % 5 == 0) ? '\'' : 'x';
+        }
+        std::vector<size_t> expected, got;
+        for (size_t i = CharScan::findHTMLStructural(data); i != std::string_view::npos; i = CharScan::findHTMLStructural(data, i + 1)) {
+            expected.push_back(i);
+        }
+        CharScan::forEach<'<', '>', '@', '"', '\''>(data, [&](size_t i) { got.push_back(i); return true; });
+        CHECK(got == expected && expected.size() > 100);
+
+        got.clear();
+        CharScan::forEach<'<'>(data, [&](size_t i) { got.push_back(i); return got.size() < 3; });
+        CHECK(got.size() == 3 && got[2] == 26);
+        std::cout << "  [PASS] forEach" << std::endl;
+    }
+
+    {
+        // 3. Bytes above 0x7f must not match signed comparisons by accident
+        std::string data(100, '\xbc');
+        CHECK(CharScan::findFirstOf<'<'>(data) == std::string_view::npos);
+        data[70] = '<';
+        CHECK(CharScan::findFirstOf<'<'>(data) == 70);
+        CHECK(CharScan::findFirstOf<0xbc>(data, 3) == 3);
+        std::cout << "  [PASS] High bytes" << std::endl;
+    }
+
+    {
+        // 4. Empty input and from past the end
+        CHECK(CharScan::findHTMLStructural("") == std::string_view::npos);
+        CHECK(CharScan::findHTMLStructural("<a>", 3) == std::string_view::npos);
+        CHECK(CharScan::findMarkdownStructural("plain text then **bold**") == 16);
+        std::cout << "  [PASS] Edges" << std::endl;
+    }
+
+    std::cout << "All tests passed!" << std::endl;
+    return 0;
+}
+
+// ---- Inputs -----------------------------------------------------------------
+
+// test.html repeated to a realistic page size, and a generated Markdown document
+struct Inputs {
+    std::string page;
+    std::string markdown;
+};
+
+static const Inputs& GetInputs() {
+    static Inputs inputs = [] {
+        Inputs i;
+        std::ifstream file("akeno/misc/test.html", std::ios::binary);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        std::string html = contents.str();
+        if (html.empty()) {
+            html = "<!DOCTYPE html><html><head><title>Test</title></head><body><div class=\"content\">Hello @name</div></body></html>\n";
+        }
+        while (i.page.length() < 256 * 1024) {
+            i.page += html;
+        }
+
+        const std::string paragraph = "Akeno serves static and processed files from memory, see the [documentation](https://example.com) for the "
+            "configuration options. Most of this text has no markup at all, which is what makes skipping it fast worth it.\n\n";
+        while (i.markdown.length() < 4 * 1024 * 1024) {
+            i.markdown += "## Section\n\n" + paragraph + paragraph + "Some **bold** and `code`.\n\n";
+        }
+        return i;
+    }();
+    return inputs;
+}
+
+template <class Scan>
+static void ScanAll(benchmark::State& state, const std::string& data, Scan scan) {
+    for (auto _ : state) {
+        size_t hits = 0;
+        for (size_t i = scan(data, 0); i != std::string_view::npos; i = scan(data, i + 1)) {
+            hits++;
+        }
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) data.length());
+}
+
+// ---- Benchmarks -------------------------------------------------------------
+
+static void BM_HTMLScalar(benchmark::State& state) {
+    ScanAll(state, GetInputs().page, ScalarHTMLStructural);
+}
+BENCHMARK(BM_HTMLScalar);
+
+static void BM_HTMLVector(benchmark::State& state) {
+    ScanAll(state, GetInputs().page, [](std::string_view data, size_t from) { return CharScan::findHTMLStructural(data, from); });
+}
+BENCHMARK(BM_HTMLVector);
+
+static void BM_HTMLVectorEach(benchmark::State& state) {
+    const std::string& data = GetInputs().page;
+    for (auto _ : state) {
+        size_t hits = 0;
+        CharScan::forEach<'<', '>', '@', '"', '\''>(data, [&](size_t) { hits++; return true; });
+        benchmark::DoNotOptimize(hits);
+    }
+    state.SetBytesProcessed((int64_t) state.iterations() * (int64_t) data.length());
+}
+BENCHMARK(BM_HTMLVectorEach);
+
+static void BM_MarkdownFindFirstOf(benchmark::State& state) {
+    ScanAll(state, GetInputs().markdown, [](std::string_view data, size_t from) { return data.find_first_of("*_`[]!<\\", from); });
+}
+BENCHMARK(BM_MarkdownFindFirstOf);
+
+static void BM_MarkdownVector(benchmark::State& state) {
+    ScanAll(state, GetInputs().markdown, [](std::string_view data, size_t from) { return CharScan::findMarkdownStructural(data, from); });
+}
+BENCHMARK(BM_MarkdownVector);
+
+// The '@' test onText does on every text run
+static void BM_AtSymbolFind(benchmark::State& state) {
+    ScanAll(state, GetInputs().markdown, [](std::string_view data, size_t from) { return data.find('@', from); });
+}
+BENCHMARK(BM_AtSymbolFind);
+
+static void BM_AtSymbolVector(benchmark::State& state) {
+    ScanAll(state, GetInputs().markdown, [](std::string_view data, size_t from) { return CharScan::findFirstOf<'@'>(data, from); });
+}
+BENCHMARK(BM_AtSymbolVector);
+
+int main(int argc, char** argv) {
+    try {
+        if (runTests()) {
+            return 1;
+        }
+        ::benchmark::Initialize(&argc, argv);
+        if (::benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+        ::benchmark::RunSpecifiedBenchmarks();
+        ::benchmark::Shutdown();
+    } catch (const std::exception& e) {
+        std::cerr << "Test failed with exception: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+/* Compares young generation GC activity between a regular route and one
+ * registered with { pooled: true }, where req/res wrappers are reused.
+ * Both handlers respond synchronously, so the pooled route allocates no
+ * wrapper objects once the pool is warm. */
+
+const uWS = require('../dist/uws.js');
+const http = require('http');
+const { PerformanceObserver, constants } = require('perf_hooks');
+
+const port = 9002;
+const requests = 50000;
+const concurrency = 32;
+
+let minorGCs = 0;
+let minorGCTime = 0;
+
+new PerformanceObserver((list) => {
+    for (const entry of list.getEntries()) {
+        if (entry.detail && entry.detail.kind === constants.NODE_PERFORMANCE_GC_MINOR) {
+            minorGCs++;
+            minorGCTime += entry.duration;
+        }
+    }
+}).observe({ entryTypes: ['gc'] });
+
+const app = new uWS.App();
+const protocol = new uWS.HTTPProtocol();
+
+const handler = (req, res) => res.end(req.path);
+app.route('regular.localhost', handler);
+app.route('pooled.localhost', handler, { pooled: true });
+
+const agent = new http.Agent({ keepAlive: true, maxSockets: concurrency });
+
+function get(host) {
+    return new Promise((resolve, reject) => {
+        http.get({ host: '127.0.0.1', port, path: '/', agent, headers: { host } }, (res) => {
+            res.resume();
+            res.on('end', resolve);
+        }).on('error', reject);
+    });
+}
+
+async function run(host) {
+    let remaining = requests;
+    const worker = async () => {
+        while (remaining-- > 0) await get(host);
+    };
+
+    global.gc && global.gc();
+    await new Promise((resolve) => setImmediate(resolve));
+
+    minorGCs = 0;
+    minorGCTime = 0;
+    const start = process.hrtime.bigint();
+
+    await Promise.all(Array.from({ length: concurrency }, worker));
+
+    /* Let the observer flush */
+    await new Promise((resolve) => setTimeout(resolve, 100));
+
+    const ms = Number(process.hrtime.bigint() - start) / 1e6;
+    console.log(`${host.padEnd(18)} ${(requests / ms * 1000).toFixed(0).padStart(7)} req/s, ${String(minorGCs).padStart(4)} minor GCs (${minorGCTime.toFixed(1)} ms)`);
+}
+
+protocol.listen(port, async (listenSocket) => {
+    if (!listenSocket) {
+        console.log('Failed to listen to port ' + port);
+        process.exit(1);
+    }
+
+    /* Warm up both routes (and the pool) first */
+    await run('regular.localhost');
+    await run('pooled.localhost');
+
+    console.log('---');
+    await run('regular.localhost');
+    await run('pooled.localhost');
+
+    process.exit(0);
+}).bind(app);
@@ -168,7 +168,9 @@ const p = 8089, p2 = 8090;
 const httpProtocol = new uws.HTTPProtocol();
 const httpsProtocol = new uws.HTTPSProtocol({
     key_file_name: "/www/dev/cert/key.pem",
-    cert_file_name: "/www/dev/cert/cert.pem"
+    cert_file_name: "/www/dev/cert/cert.pem",
+    // streamFile over TLS uses kernel TLS where the kernel has it, user space encryption otherwise
+    ktls: true
 });
 
 httpProtocol.listen(p, (socket) => console.log(socket)).bind(app);
@@ -177,16 +179,17 @@ httpsProtocol.listen(p2, (socket) => console.log(socket)).bind(app);
 let tspmo = [];
 
 // Helper to make HTTP/HTTPS requests with custom Host header
-function makeRequest(protocol, port, host) {
+function makeRequest(protocol, port, host, method = 'GET', headers = {}) {
     return new Promise((resolve, reject) => {
         const client = protocol === 'https' ? https : http;
         const options = {
             hostname: '127.0.0.1',
             port: port,
             path: '/',
-            method: 'GET',
+            method,
             headers: {
-                'Host': host
+                'Host': host,
+                ...headers
             },
             rejectUnauthorized: false // For self-signed certs
         };
@@ -196,7 +199,7 @@ function makeRequest(protocol, port, host) {
             res.on('data', (chunk) => chunks.push(chunk));
             res.on('end', () => {
                 const buffer = Buffer.concat(chunks);
-                resolve({ status: res.statusCode, buffer });
+                resolve({ status: res.statusCode, headers: res.headers, buffer, text: buffer.toString() });
             });
         });
 
@@ -205,6 +208,11 @@ function makeRequest(protocol, port, host) {
     });
 }
 
+// Plain request for generic tests, by protocol name
+function request(protocol, host, method, headers) {
+    return makeRequest(protocol, protocol === 'https' ? p2 : p, host, method, headers);
+}
+
 let currentLabel = "";
 function label(text) {
     tspmo.push(() => {
@@ -239,7 +247,7 @@ function generic_test(name, fn) {
 }
 
 // Test utility function
-function http_test(testString, handler, expected) {
+function http_test(testString, handler, expected, routeOptions) {
     return tspmo.push(async () => {
         const [hostPart, commentPart] = testString.replaceAll("$id", () => id).split("#").map((s) => s.trim());
         const { hostPattern, realHosts, blockedHosts } = parseHostPart(hostPart);
@@ -249,7 +257,7 @@ function http_test(testString, handler, expected) {
             ? `MATCH ${comment} [${hostPattern}]`
             : expected;
 
-        app.route(hostPattern, typeof handler === "function" ? handler(expectedValue) : handler);
+        app.route(hostPattern, typeof handler === "function" ? handler(expectedValue) : handler, routeOptions);
 
         try {
             // Test against both HTTP and HTTPS
@@ -397,6 +405,7 @@ module.exports = {
     label,
     generic_test,
     http_test,
+    request,
     runTestsInOrder,
     paint,
     EXPECT_MATCH,
@@ -1,5 +1,8 @@
-const { uws, app, label, generic_test, http_test, runTestsInOrder, paint, EXPECT_MATCH, WRITE_VALUE } = require("./misc/tester");
+const { uws, app, label, generic_test, http_test, request, runTestsInOrder, paint, EXPECT_MATCH, WRITE_VALUE } = require("./misc/tester");
 const stream = require('stream');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
 
 // -- Begin tests --
 
@@ -23,6 +26,15 @@ generic_test("HTMLParser fromMarkdownString", (ctx) => {
     ctx.logPass({ summary: result.toString() });
 });
 
+generic_test("HTMLParser fromMarkdownString with a Buffer", (ctx) => {
+    const result = parser.fromMarkdownString(Buffer.from("# Hello Buffer\n"), parser.createContext());
+    if (!Buffer.isBuffer(result) || !result.toString().includes("<h1>Hello Buffer</h1>")) {
+        throw new Error("Markdown parsing from a Buffer failed");
+    }
+
+    ctx.logPass({ summary: result.toString() });
+});
+
 // HTML parsing is too volatile to test exactly
 generic_test("HTMLParser fromFile", (ctx) => {
     const result = parser.fromFile(__dirname + "/misc/test.html", parser.createContext());
@@ -33,11 +45,169 @@ generic_test("HTMLParser fromFile", (ctx) => {
     ctx.logPass({ summary: result.toString().slice(0, 100).replaceAll("\n", "").replaceAll("\r", "") + "..." });
 });
 
+generic_test("HTMLParser compile and render", (ctx) => {
+    const templateParser = new uws.HTMLParser({
+        buffer: true,
+        onText: (text, parent, context) => text.replace("@name", context.data.name)
+    });
+
+    const template = templateParser.compile("<div>Hello @name</div>");
+    const first = template.render({ name: "World" }).toString(), second = template.render({ name: "Akeno" }).toString();
+    if (!first.includes("Hello World") || !second.includes("Hello Akeno")) {
+        throw new Error("Template rendering failed");
+    }
+
+    ctx.logPass({ summary: second });
+});
+
+generic_test("HTMLParser compile watches included files", async (ctx) => {
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), "akeno-compile-"));
+    const page = path.join(dir, "page.html"), footer = path.join(dir, "footer.html");
+    fs.writeFileSync(footer, "<p>Footer</p>");
+    fs.writeFileSync(page, "<div>Page</div><site-footer></site-footer>");
+
+    const includeParser = new uws.HTMLParser({ buffer: true, directives: { "site-footer": { include: footer } } });
+    const template = includeParser.compile(page, true);
+    if (!template.render({}).toString().includes("Footer") || includeParser.needsUpdate(page)) {
+        throw new Error("Include was not compiled in");
+    }
+
+    fs.writeFileSync(footer, "<p>Changed</p>");
+    await new Promise((resolve) => setTimeout(resolve, 100));
+    fs.rmSync(dir, { recursive: true });
+    if (!includeParser.needsUpdate(page)) {
+        throw new Error("Change of an included file was not noticed");
+    }
+
+    ctx.logPass();
+});
+
+generic_test("HTMLParser failed include directive", (ctx) => {
+    const includeParser = new uws.HTMLParser({ buffer: true, directives: { "missing-part": { include: path.join(os.tmpdir(), "akeno-missing-include.html") } } });
+    try {
+        includeParser.fromString("<div><missing-part></missing-part></div>", includeParser.createContext());
+    } catch (error) {
+        ctx.logPass({ summary: error.message });
+        return;
+    }
+    throw new Error("A missing include was not reported");
+});
+
+generic_test("HTMLParser native directives", (ctx) => {
+    const directiveParser = new uws.HTMLParser({
+        buffer: true,
+        directives: {
+            "user-name": { text: "user.name" },
+            "admin-only": { if: "user.admin" }
+        }
+    });
+
+    const result = directiveParser.fromString("<p>Hi <user-name></user-name></p><admin-only>secret</admin-only>",
+        directiveParser.createContext({ user: { name: "<Ann>", admin: false } })).toString();
+    if (!result.includes("Hi &lt;Ann&gt;") || result.includes("secret")) {
+        throw new Error("Directives were not applied");
+    }
+
+    ctx.logPass({ summary: result });
+});
+
 label("Testing routing");
 http_test(`$id.localhost # Direct response`, WRITE_VALUE, EXPECT_MATCH);
 http_test(`$id.localhost # Write in chunks`,
     (v) => (r, q) => { q.write(v.slice(0, 5)); q.write(v.slice(5)); q.end() },
     EXPECT_MATCH);
+http_test(`$id.localhost # Chained writes with non-ASCII text`,
+    (v) => (r, q) => q.writeStatus("200 OK").writeHeader("x-test", "1").end(v),
+    "Héllo wörld ✓");
+http_test(`$id.localhost # Lazy request properties`,
+    (v) => (r, q) => q.end(`${r.method} ${r.path} ${r.path} ${r.domain === r.host.split(":")[0]} ${r.contentType}`),
+    (res) => res.text === "GET / / true undefined");
+http_test(`$id.localhost # Lazy request properties after await`,
+    () => async (r, q) => {
+        q.onAborted(() => {});
+        await new Promise((resolve) => setTimeout(resolve, 10));
+        q.cork(() => q.end(`${r.method} ${r.path}`));
+    },
+    "GET /");
+http_test(`$id.localhost # Pooled route`,
+    () => (r, q) => {
+        // Requests share the wrapper, nothing set by an earlier one may show up
+        const leaked = r.user;
+        try { r.user = "someone"; } catch {}
+        q.end(`${r.method} ${r.path} ${leaked}`);
+    },
+    "GET / undefined",
+    { pooled: true });
+http_test(`$id.localhost # Pooled route with an async handler`,
+    () => async (r, q) => {
+        q.onAborted(() => {});
+        await new Promise((resolve) => setTimeout(resolve, 10));
+        q.cork(() => q.end(`${r.method} ${r.path}`));
+    },
+    "GET /",
+    { pooled: true });
+http_test(`$id.localhost # Bulk header read`,
+    (v) => (r, q) => {
+        const all = r.getHeaders();
+        const [host, missing] = r.getHeaders(["host", "x-missing"]);
+        q.end(`${all[all.indexOf("host") + 1] === host} ${missing === ""}`);
+    },
+    "true true");
+http_test(`$id.localhost # Single-call response`,
+    () => (r, q) => q.respond("201 Created", ["content-type", "text/plain", "x-count", 2], "Hello world"),
+    (res) => res.status === 201 && res.text === "Hello world");
+http_test(`$id.localhost # Single-call response with invalid and numeric headers`,
+    () => (r, q) => {
+        try {
+            q.respond("500 Internal Server Error", ["x-bad", {}], "Not sent");
+        } catch {
+            q.respond("200 OK", ["x-fraction", 1.5, "x-negative", -1], "Hello world");
+        }
+    },
+    (res) => res.status === 200 && res.text === "Hello world" && res.headers["x-fraction"] === "1.5" && res.headers["x-negative"] === "-1");
+// Four requests to the same host, only the first one reaches the handler
+http_test(`cached.localhost (cached.localhost, cached.localhost) # Cached route response`,
+    () => {
+        let calls = 0;
+        return (r, q) => q.writeHeader("x-calls", String(++calls)).end("Hello world");
+    },
+    (res) => res.text === "Hello world" && res.headers["x-calls"] === "1",
+    { cache: { ttl: 60000 } });
+generic_test("Cached route response is only used for GET", async (ctx) => {
+    let calls = 0;
+    app.route("cached-post.localhost", (r, q) => q.writeHeader("x-calls", String(++calls)).end(r.method), { cache: { ttl: 60000 } });
+
+    const first = await request("http", "cached-post.localhost");
+    const post = await request("http", "cached-post.localhost", "POST");
+    const second = await request("http", "cached-post.localhost");
+    if (first.headers["x-calls"] !== "1" || post.text !== "POST" || post.headers["x-calls"] !== "2" || second.text !== "GET" || second.headers["x-calls"] !== "1") {
+        throw new Error("POST was served from or stored in the cache");
+    }
+
+    ctx.logPass({ summary: `GET ${first.headers["x-calls"]}, POST ${post.headers["x-calls"]}, GET ${second.headers["x-calls"]}` });
+});
+generic_test("Cached route skips private requests and responses", async (ctx) => {
+    let calls = 0, noStoreCalls = 0;
+    app.route("cached-private.localhost", (r, q) => q.writeHeader("x-calls", String(++calls)).end("Hello"), { cache: { ttl: 60000 } });
+    app.route("cached-nostore.localhost", (r, q) => q.writeHeader("Cache-Control", "No-Store").writeHeader("x-calls", String(++noStoreCalls)).end("Hello"), { cache: { ttl: 60000 } });
+
+    const authorized = await request("http", "cached-private.localhost", "GET", { authorization: "Bearer secret" });
+    const cookie = await request("http", "cached-private.localhost", "GET", { cookie: "session=1" });
+    const plain = await request("http", "cached-private.localhost");
+    const again = await request("http", "cached-private.localhost");
+    const withCookie = await request("http", "cached-private.localhost", "GET", { cookie: "session=1" });
+    if (authorized.headers["x-calls"] !== "1" || cookie.headers["x-calls"] !== "2" || plain.headers["x-calls"] !== "3" || again.headers["x-calls"] !== "3" || withCookie.headers["x-calls"] !== "4") {
+        throw new Error("A request with credentials was served from or stored in the cache");
+    }
+
+    await request("http", "cached-nostore.localhost");
+    const noStore = await request("http", "cached-nostore.localhost");
+    if (noStore.headers["x-calls"] !== "2") {
+        throw new Error("A Cache-Control: no-store response was stored");
+    }
+
+    ctx.logPass({ summary: `authorization ${authorized.headers["x-calls"]}, cookie ${cookie.headers["x-calls"]}, plain ${plain.headers["x-calls"]}, ${again.headers["x-calls"]}, cookie ${withCookie.headers["x-calls"]}, no-store ${noStore.headers["x-calls"]}` });
+});
 http_test(`random # 404 response`, null, (res) => res.status === 404);
 http_test(`*.localhost ($id.localhost, $id.localhost, !nope.$id.localhost) # Wildcard with multiple real hosts`, WRITE_VALUE, EXPECT_MATCH);
 http_test(`test.*.localhost (test.$id.localhost, !$id.nope.localhost) # Wildcard in the middle`, WRITE_VALUE, EXPECT_MATCH);
@@ -53,11 +223,25 @@ http_test(`** (any.host.at.all) # Match all`, WRITE_VALUE, EXPECT_MATCH);
 label("Testing serving capabilities");
 const file = new uws.HTMLParser({ buffer: true }).fromFile(__dirname + "/misc/test.html", {});
 http_test(`$id.localhost # Serving parsed HTML file`, WRITE_VALUE, file);
+http_test(`$id.localhost # Rendering parsed HTML into the response`,
+    () => (r, q) => parser.renderTo(q, __dirname + "/misc/test.html", parser.createContext()),
+    (res) => res.status === 200 && res.text.includes("<!DOCTYPE html>"));
 
 http_test(`$id.localhost # Serving file as a stream`, (v) => (r, q) => {
     q.streamFile(__dirname + "/misc/test.html");
 }, (res) => res.status === 200);
 
+http_test(`$id.localhost # Serving a range of a file`, () => (r, q) => {
+    q.streamFile(__dirname + "/misc/test.html", { range: "bytes=0-14", contentType: "text/html" });
+}, (res) => res.status === 206 && res.text === "<!DOCTYPE html>" && res.headers["content-range"].startsWith("bytes 0-14/"));
+
+const largeFilePath = path.join(os.tmpdir(), `akeno-stream-${process.pid}.bin`);
+fs.writeFileSync(largeFilePath, Buffer.alloc(24 * 1024 * 1024 + 7, "0123456789abcdef"));
+process.on("exit", () => fs.rmSync(largeFilePath, { force: true }));
+http_test(`$id.localhost # Streaming a large file (~24MB)`, () => (r, q) => {
+    q.streamFile(largeFilePath);
+}, (res) => res.status === 200 && res.buffer.equals(fs.readFileSync(largeFilePath)));
+
 let large = new Array(10000).fill("Hello world! This is a particularly large file used in testing. It has no other meaning. ".repeat(10)).join("\n");
 http_test(`$id.localhost # Serving large file as a copied string (~9MB)`, WRITE_VALUE, large);
 
@@ -103,6 +287,15 @@ const testWebApp = new uws.WebApp(__dirname + "/misc");
 
 app.route("test.localhost", testWebApp);
 
+generic_test("WebApp cacheStats", (ctx) => {
+    const stats = testWebApp.cacheStats();
+    if (typeof stats.misses !== "number" || (stats.maxBytes && stats.variantBytes > stats.maxBytes)) {
+        throw new Error("Unexpected cache stats");
+    }
+
+    ctx.logPass({ summary: JSON.stringify(stats) });
+});
+
 app.registerFileProcessor((id, url, path) => {
     console.log(paint("blue", `File processor called for ${url} (path: ${path})`), id);
     
@@ -130,7 +323,10 @@ http_test(`$id.localhost # Asynchronous response`, (v) => (r, q) => {
 // test(`buffer.localhost # Buffer response`,
 //    Buffer.from("Hello world").buffer, "Hello world");
 
-// label("Testing DeclarativeResponse");
+label("Testing DeclarativeResponse");
+http_test(`$id.localhost # Declarative response`,
+    new uws.DeclarativeResponse().writeHeader("content-type", "text/plain").write("Héllo ").writeQueryValue("missing").end("wörld"),
+    "Héllo wörld");
 
 runTestsInOrder().then(() => {
     console.log(paint("green", "All tests passed!"));